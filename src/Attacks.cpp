@@ -0,0 +1,148 @@
+#include "Attacks.h"
+#include <cassert>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// Every square gets 2^popcount(mask) entries, which is enough for both
+// magic and PEXT indexing
+static constexpr std::size_t ROOK_TABLE_SIZE = 102400;
+static constexpr std::size_t BISHOP_TABLE_SIZE = 5248;
+
+static Bitboard s_rook_table[ROOK_TABLE_SIZE];
+static Bitboard s_bishop_table[BISHOP_TABLE_SIZE];
+
+SlidingMagic RookMagics[64];
+SlidingMagic BishopMagics[64];
+
+static SlidingIndex s_sliding_index = SlidingIndexMagic;
+
+static const int s_rook_directions[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+static const int s_bishop_directions[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+static Bitboard sliding_attacks(Square square, const int (&directions)[4][2], Bitboard occupancy)
+{
+	Bitboard attacks = 0;
+	for (const auto &d : directions)
+		attacks |= SlidingRay(square, d[0], d[1], occupancy);
+
+	return attacks;
+}
+
+// xorshift64*, seeded with constants so the magics found are the same on
+// every run. The per-row seeds are known to find magics quickly.
+static Bitboard next_random(Bitboard &state)
+{
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
+
+static const Bitboard s_magic_seeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+
+// PEXT needs BMI2, and on AMD Zen 1 and Zen 2 (family 17h) it is
+// microcoded and slower than a magic multiply
+static SlidingIndex choose_sliding_index()
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("bmi2"))
+		return SlidingIndexMagic;
+
+	unsigned eax, ebx, ecx, edx;
+	if (__builtin_cpu_is("amd") && __get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		const unsigned family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+		if (family == 0x17)
+			return SlidingIndexMagic;
+	}
+	return SlidingIndexPext;
+#else
+	return SlidingIndexMagic;
+#endif
+}
+
+SlidingIndex ActiveSlidingIndex()
+{
+	return s_sliding_index;
+}
+
+static void init_sliding_table(SlidingMagic (&magics)[64], Bitboard *table, std::size_t table_size, const int (&directions)[4][2])
+{
+	Bitboard occupancies[4096];
+	Bitboard attacks[4096];
+	unsigned epoch[4096] = {};
+	unsigned attempt = 0;
+
+	Bitboard *next_attacks = table;
+
+	for (Square square = 0; square < 64; square++) {
+		SlidingMagic &m = magics[square];
+
+		// Squares on the edge of a ray never block anything beyond them,
+		// so they are left out of the mask unless the piece sits on that edge
+		const std::size_t x = SquareX(square);
+		const std::size_t y = SquareY(square);
+		const Bitboard edges = ((BitboardFileA | BitboardFileH) & ~FileBit(x))
+			| ((BitboardRow0 | BitboardRow7) & ~RowBit(y));
+
+		m.mask = sliding_attacks(square, directions, 0) & ~edges;
+		m.shift = 64 - PopCount(m.mask);
+		Bitboard *const entries = next_attacks;
+		m.attacks = entries;
+
+		// Enumerate every subset of the mask (Carry-Rippler)
+		std::size_t size = 0;
+		Bitboard subset = 0;
+		do {
+			occupancies[size] = subset;
+			attacks[size] = sliding_attacks(square, directions, subset);
+			size++;
+			subset = (subset - m.mask) & m.mask;
+		} while (subset);
+
+		next_attacks += size;
+		assert(next_attacks <= table + table_size && "Sliding attack table too small");
+
+		if (s_sliding_index == SlidingIndexPext) {
+			for (std::size_t i = 0; i < size; i++)
+				entries[m.IndexOf<SlidingIndexPext>(occupancies[i])] = attacks[i];
+			continue;
+		}
+
+		// Try sparse random numbers until one maps every subset without
+		// a destructive collision
+		Bitboard random_state = s_magic_seeds[y];
+		for (bool found = false; !found;) {
+			m.magic = next_random(random_state) & next_random(random_state) & next_random(random_state);
+			if (PopCount((m.mask * m.magic) >> 56) < 6)
+				continue;
+
+			attempt++;
+			found = true;
+			for (std::size_t i = 0; i < size; i++) {
+				const std::size_t index = m.IndexOf<SlidingIndexMagic>(occupancies[i]);
+				if (epoch[index] < attempt) {
+					epoch[index] = attempt;
+					entries[index] = attacks[i];
+				} else if (entries[index] != attacks[i]) {
+					found = false;
+					break;
+				}
+			}
+		}
+	}
+}
+
+static bool init_attack_tables()
+{
+	s_sliding_index = choose_sliding_index();
+
+	init_sliding_table(RookMagics, s_rook_table, ROOK_TABLE_SIZE, s_rook_directions);
+	init_sliding_table(BishopMagics, s_bishop_table, BISHOP_TABLE_SIZE, s_bishop_directions);
+
+	return true;
+}
+
+static const bool s_attack_tables_ready = init_attack_tables();
@@ -0,0 +1,224 @@
+#ifndef ATTACKS_INCLUDE_H
+#define ATTACKS_INCLUDE_H
+#include "Bitboard.h"
+#include "ChessPiece.h"
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+typedef std::array<Bitboard, 64> SquareTable;
+
+constexpr Bitboard KnightAttacksFromSet(Bitboard b)
+{
+	return ShiftBitboard(b, 1, 2) | ShiftBitboard(b, 1, -2)
+		| ShiftBitboard(b, -1, 2) | ShiftBitboard(b, -1, -2)
+		| ShiftBitboard(b, 2, 1) | ShiftBitboard(b, 2, -1)
+		| ShiftBitboard(b, -2, 1) | ShiftBitboard(b, -2, -1);
+}
+
+constexpr Bitboard KingAttacksFromSet(Bitboard b)
+{
+	return ShiftBitboard(b, 0, 1) | ShiftBitboard(b, 0, -1)
+		| ShiftBitboard(b, 1, 0) | ShiftBitboard(b, -1, 0)
+		| ShiftBitboard(b, 1, 1) | ShiftBitboard(b, 1, -1)
+		| ShiftBitboard(b, -1, 1) | ShiftBitboard(b, -1, -1);
+}
+
+// White pawns move up the board (towards y = 0), black pawns move down
+constexpr int PawnDirection(Player player)
+{
+	return (player == PlayerWhite) ? -1 : 1;
+}
+
+constexpr Bitboard PawnAttacksFromSet(Player player, Bitboard b)
+{
+	return ShiftBitboard(b, 1, PawnDirection(player)) | ShiftBitboard(b, -1, PawnDirection(player));
+}
+
+constexpr SquareTable MakeKnightTable()
+{
+	SquareTable table = {};
+	for (Square square = 0; square < 64; square++)
+		table[square] = KnightAttacksFromSet(SquareBit(square));
+	return table;
+}
+
+constexpr SquareTable MakeKingTable()
+{
+	SquareTable table = {};
+	for (Square square = 0; square < 64; square++)
+		table[square] = KingAttacksFromSet(SquareBit(square));
+	return table;
+}
+
+constexpr SquareTable MakePawnTable(Player player)
+{
+	SquareTable table = {};
+	for (Square square = 0; square < 64; square++)
+		table[square] = PawnAttacksFromSet(player, SquareBit(square));
+	return table;
+}
+
+// Leaper attacks are generated at compile time
+inline constexpr SquareTable KnightAttackTable = MakeKnightTable();
+inline constexpr SquareTable KingAttackTable = MakeKingTable();
+inline constexpr SquareTable PawnAttackTable[PlayerNone] = { MakePawnTable(PlayerWhite), MakePawnTable(PlayerBlack) };
+
+static_assert(KnightAttackTable[0] == (SquareBit(10) | SquareBit(17)), "Knight table is wrong");
+static_assert(PawnAttackTable[PlayerWhite][9] == (SquareBit(0) | SquareBit(2)), "Pawn table is wrong");
+
+inline Bitboard KnightAttacks(Square square)
+{
+	return KnightAttackTable[square];
+}
+
+inline Bitboard KingAttacks(Square square)
+{
+	return KingAttackTable[square];
+}
+
+// Squares a pawn of player standing on square captures on
+inline Bitboard PawnAttacks(Player player, Square square)
+{
+	return PawnAttackTable[player][square];
+}
+
+typedef std::array<SquareTable, 64> SquarePairTable;
+
+inline constexpr int LineDirections[8][2] = {
+	{ 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+	{ 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 }
+};
+
+constexpr SquarePairTable MakeBetweenTable()
+{
+	SquarePairTable table = {};
+	for (Square from = 0; from < 64; from++) {
+		for (const auto &d : LineDirections) {
+			Bitboard between = 0;
+			Bitboard b = SquareBit(from);
+			while ((b = ShiftBitboard(b, d[0], d[1]))) {
+				table[from][LowestSquare(b)] = between;
+				between |= b;
+			}
+		}
+	}
+	return table;
+}
+
+constexpr SquarePairTable MakeLineTable()
+{
+	SquarePairTable table = {};
+	for (Square from = 0; from < 64; from++) {
+		for (const auto &d : LineDirections) {
+			const Bitboard line = SlidingRay(from, d[0], d[1], 0) | SlidingRay(from, -d[0], -d[1], 0) | SquareBit(from);
+			Bitboard ray = SlidingRay(from, d[0], d[1], 0);
+			while (ray)
+				table[from][PopLowestSquare(ray)] = line;
+		}
+	}
+	return table;
+}
+
+// Squares strictly between two squares on the same row, column or
+// diagonal, and the whole board-wide line through them. Both are empty
+// for squares that don't share a line.
+inline constexpr SquarePairTable BetweenTable = MakeBetweenTable();
+inline constexpr SquarePairTable LineTable = MakeLineTable();
+
+inline Bitboard Between(Square a, Square b)
+{
+	return BetweenTable[a][b];
+}
+
+inline Bitboard Line(Square a, Square b)
+{
+	return LineTable[a][b];
+}
+
+// How the sliding attack tables are indexed. PEXT is picked once at
+// startup on CPUs with a fast one; anything hot is instantiated for both
+// schemes, so the lookups inline with no per-lookup branch.
+enum SlidingIndex : std::uint8_t {
+	SlidingIndexMagic,
+	SlidingIndexPext
+};
+
+// Parallel bit extract. Written as inline assembly so it can be used
+// without building the whole tree for BMI2; it only runs once the CPU
+// has been checked for it.
+inline Bitboard ExtractBits(Bitboard value, Bitboard mask)
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+	Bitboard result;
+	__asm__("pextq %2, %1, %0" : "=r"(result) : "r"(value), "rm"(mask));
+	return result;
+#else
+	Bitboard result = 0;
+	for (Bitboard bit = 1; mask; bit <<= 1) {
+		if (value & mask & -mask)
+			result |= bit;
+		mask &= mask - 1;
+	}
+	return result;
+#endif
+}
+
+struct SlidingMagic {
+	Bitboard mask;
+	Bitboard magic;
+	const Bitboard *attacks;
+	unsigned shift;
+
+	template <SlidingIndex Index>
+	std::size_t IndexOf(Bitboard occupancy) const
+	{
+		if constexpr (Index == SlidingIndexPext)
+			return ExtractBits(occupancy, mask);
+		else
+			return ((occupancy & mask) * magic) >> shift;
+	}
+};
+
+// Built once during static initialization in Attacks.cpp
+extern SlidingMagic RookMagics[64];
+extern SlidingMagic BishopMagics[64];
+
+// The scheme the tables were built for. Lookups must use this one.
+SlidingIndex ActiveSlidingIndex();
+
+// Calls f with the active SlidingIndex as a std::integral_constant, so
+// everything it calls is instantiated for that scheme. Used once at the
+// top of anything hot.
+template <typename F>
+decltype(auto) WithSlidingIndex(F &&f)
+{
+	if (ActiveSlidingIndex() == SlidingIndexPext)
+		return f(std::integral_constant<SlidingIndex, SlidingIndexPext>());
+	return f(std::integral_constant<SlidingIndex, SlidingIndexMagic>());
+}
+
+// Sliding piece attacks from square given the board occupancy. The
+// returned set includes the first blocker in every direction, whoever
+// owns it.
+template <SlidingIndex Index>
+inline Bitboard RookAttacks(Square square, Bitboard occupancy)
+{
+	const SlidingMagic &m = RookMagics[square];
+	return m.attacks[m.IndexOf<Index>(occupancy)];
+}
+
+template <SlidingIndex Index>
+inline Bitboard BishopAttacks(Square square, Bitboard occupancy)
+{
+	const SlidingMagic &m = BishopMagics[square];
+	return m.attacks[m.IndexOf<Index>(occupancy)];
+}
+
+template <SlidingIndex Index>
+inline Bitboard QueenAttacks(Square square, Bitboard occupancy)
+{
+	return RookAttacks<Index>(square, occupancy) | BishopAttacks<Index>(square, occupancy);
+}
+
+#endif // ATTACKS_INCLUDE_H
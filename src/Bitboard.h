@@ -0,0 +1,102 @@
+#ifndef BITBOARD_INCLUDE_H
+#define BITBOARD_INCLUDE_H
+#include <cstddef>
+#include <cstdint>
+
+// A set of squares, one bit per square. Squares are numbered y * 8 + x
+// using the same top left origin as ChessPieceLocation, so bit 0 is the
+// top left tile and bit 63 is the bottom right tile.
+typedef std::uint64_t Bitboard;
+
+// Index of a square in a Bitboard, 0 - 63
+typedef std::uint8_t Square;
+
+constexpr Square SquareNone = 64;
+
+constexpr Square MakeSquare(std::size_t x, std::size_t y)
+{
+	return Square(y * 8 + x);
+}
+
+constexpr std::size_t SquareX(Square square)
+{
+	return square & 7;
+}
+
+constexpr std::size_t SquareY(Square square)
+{
+	return square >> 3;
+}
+
+constexpr Bitboard BitboardFileA = 0x0101010101010101ULL;
+constexpr Bitboard BitboardFileH = BitboardFileA << 7;
+constexpr Bitboard BitboardRow0 = 0xFFULL;
+constexpr Bitboard BitboardRow7 = BitboardRow0 << 56;
+
+constexpr Bitboard SquareBit(Square square)
+{
+	return Bitboard(1) << square;
+}
+
+constexpr Bitboard FileBit(std::size_t x)
+{
+	return BitboardFileA << x;
+}
+
+constexpr Bitboard RowBit(std::size_t y)
+{
+	return BitboardRow0 << (y * 8);
+}
+
+// Moves every square by (dx, dy), dropping the ones that fall off the board
+// instead of letting them wrap around to the other side
+constexpr Bitboard ShiftBitboard(Bitboard b, int dx, int dy)
+{
+	for (int x = 0; x < dx; x++)
+		b &= ~FileBit(7 - x);
+	for (int x = 0; x < -dx; x++)
+		b &= ~FileBit(x);
+
+	const int shift = dy * 8 + dx;
+	return (shift >= 0) ? (b << shift) : (b >> -shift);
+}
+
+// Walks from square in the (dx, dy) direction until it leaves the board
+// or hits an occupied square. The blocking square is included.
+constexpr Bitboard SlidingRay(Square square, int dx, int dy, Bitboard occupancy)
+{
+	Bitboard ray = 0;
+	Bitboard b = SquareBit(square);
+	while ((b = ShiftBitboard(b, dx, dy))) {
+		ray |= b;
+		if (b & occupancy)
+			break;
+	}
+	return ray;
+}
+
+constexpr int PopCount(Bitboard b)
+{
+	return __builtin_popcountll(b);
+}
+
+constexpr Square LowestSquare(Bitboard b)
+{
+	return Square(__builtin_ctzll(b));
+}
+
+// True when b has more than one square set
+constexpr bool HasManySquares(Bitboard b)
+{
+	return (b & (b - 1)) != 0;
+}
+
+// Removes the lowest square from b and returns it
+constexpr Square PopLowestSquare(Bitboard &b)
+{
+	const Square square = LowestSquare(b);
+	b &= b - 1;
+	return square;
+}
+
+#endif // BITBOARD_INCLUDE_H
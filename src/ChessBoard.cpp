@@ -1,25 +1,512 @@
 #include "ChessBoard.h"
+#include "Attacks.h"
+#include "Zobrist.h"
+#include <algorithm>
 
-// Return true on success
-bool ChessBoard::MovePiece(ChessPieceLocation from, ChessPieceLocation to)
-{	
-	ChessPiece pieceFrom = GetPiece(from);
+// Castling rights that survive a move touching each square. Moving a king
+// or rook, or capturing a rook at home, drops the matching rights.
+static constexpr std::uint8_t s_castling_rights_kept[64] = {
+	CastlingAll & ~CastlingBlackQueenside, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll & ~(CastlingBlackKingside | CastlingBlackQueenside), CastlingAll, CastlingAll, CastlingAll & ~CastlingBlackKingside,
+	CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll & ~CastlingWhiteQueenside, CastlingAll, CastlingAll, CastlingAll,
+	CastlingAll & ~(CastlingWhiteKingside | CastlingWhiteQueenside), CastlingAll, CastlingAll, CastlingAll & ~CastlingWhiteKingside
+};
 
-	if (!pieceFrom.IsValid())
-		return false;
+ChessBoard::ChessBoard()
+{
+	const PieceType back_row[BOARD_WIDTH] = {
+		PieceTypeRook, PieceTypeKnight, PieceTypeBishop, PieceTypeQueen,
+		PieceTypeKing, PieceTypeBishop, PieceTypeKnight, PieceTypeRook
+	};
+
+	for (std::size_t x = 0; x < BOARD_WIDTH; x++) {
+		PutPiece(MakeSquare(x, 0), ChessPiece(PlayerBlack, back_row[x]));
+		PutPiece(MakeSquare(x, 1), ChessPiece(PlayerBlack, PieceTypePawn));
+		PutPiece(MakeSquare(x, 6), ChessPiece(PlayerWhite, PieceTypePawn));
+		PutPiece(MakeSquare(x, 7), ChessPiece(PlayerWhite, back_row[x]));
+	}
+
+	m_hash = ComputeHash();
+}
+
+void ChessBoard::Clear()
+{
+	for (Bitboard &pieces : m_pieces)
+		pieces = 0;
+	for (Bitboard &players : m_players)
+		players = 0;
+
+	m_side_to_move = PlayerWhite;
+	m_castling_rights = CastlingNone;
+	m_en_passant = SquareNone;
+	m_halfmove_clock = 0;
+	m_fullmove_number = 1;
+}
+
+const char *FenErrorString(FenError error)
+{
+	switch (error) {
+		case FenErrorNone: return "no error";
+		case FenErrorPlacement: return "malformed piece placement";
+		case FenErrorKings: return "each side needs exactly one king";
+		case FenErrorPawnRow: return "pawn on the first or last row";
+		case FenErrorSideToMove: return "side to move must be w or b";
+		case FenErrorCastling: return "castling rights don't match the king and rooks";
+		case FenErrorEnPassant: return "invalid en passant square";
+		case FenErrorMoveCounters: return "malformed move counters";
+		case FenErrorOpponentInCheck: return "side not to move is in check";
+		case FenErrorTrailingText: return "unexpected text after the move counters";
+	}
+	return "unknown error";
+}
+
+static const char s_fen_piece_chars[PlayerNone][PieceTypeNone + 1] = { "PRNBQK", "prnbqk" };
+
+static bool piece_from_fen_char(char c, ChessPiece &piece)
+{
+	for (std::size_t player = PlayerWhite; player < PlayerNone; player++) {
+		for (std::size_t type = PieceTypePawn; type < PieceTypeNone; type++) {
+			if (c == s_fen_piece_chars[player][type]) {
+				piece = ChessPiece(Player(player), PieceType(type));
+				return true;
+			}
+		}
+	}
+	return false;
+}
 
-	m_board[from.y][from.x] = ChessPiece(PlayerNone, PieceTypeNone);
+// Splits off the text up to the next space
+static std::string_view next_fen_field(std::string_view &fen)
+{
+	while (!fen.empty() && fen.front() == ' ')
+		fen.remove_prefix(1);
 
-	// Move piece
-	m_board[to.y][to.x] = pieceFrom;
+	const std::size_t end = std::min(fen.find(' '), fen.size());
+	const std::string_view field = fen.substr(0, end);
+	fen.remove_prefix(end);
+	return field;
+}
 
-	// Increment move count internally
-	m_board[to.y][to.x].IncrementMoveCount();
+static bool parse_fen_number(std::string_view field, unsigned &value)
+{
+	if (field.empty() || field.size() > 5)
+		return false;
 
+	value = 0;
+	for (char c : field) {
+		if (c < '0' || c > '9')
+			return false;
+		value = value * 10 + (c - '0');
+	}
 	return true;
 }
 
-const ChessPiece &ChessBoard::GetPiece(ChessPieceLocation loc) const
+FenError ChessBoard::LoadFEN(std::string_view fen)
+{
+	Clear();
+
+	std::size_t x = 0;
+	std::size_t y = 0;
+	for (char c : next_fen_field(fen)) {
+		ChessPiece piece;
+		if (c == '/') {
+			if (x != BOARD_WIDTH || ++y >= BOARD_HEIGHT)
+				return FenErrorPlacement;
+			x = 0;
+		} else if (c >= '1' && c <= '8') {
+			x += c - '0';
+			if (x > BOARD_WIDTH)
+				return FenErrorPlacement;
+		} else if (piece_from_fen_char(c, piece) && x < BOARD_WIDTH) {
+			PutPiece(MakeSquare(x, y), piece);
+			x++;
+		} else {
+			return FenErrorPlacement;
+		}
+	}
+	if (x != BOARD_WIDTH || y != BOARD_HEIGHT - 1)
+		return FenErrorPlacement;
+
+	if (PopCount(GetPieces(PlayerWhite, PieceTypeKing)) != 1 || PopCount(GetPieces(PlayerBlack, PieceTypeKing)) != 1)
+		return FenErrorKings;
+	if (m_pieces[PieceTypePawn] & (BitboardRow0 | BitboardRow7))
+		return FenErrorPawnRow;
+
+	const std::string_view side = next_fen_field(fen);
+	if (side == "w")
+		m_side_to_move = PlayerWhite;
+	else if (side == "b")
+		m_side_to_move = PlayerBlack;
+	else
+		return FenErrorSideToMove;
+
+	const std::string_view castling = next_fen_field(fen);
+	if (castling.empty())
+		return FenErrorCastling;
+	if (castling != "-") {
+		for (char c : castling) {
+			std::uint8_t right;
+			switch (c) {
+				case 'K': right = CastlingWhiteKingside; break;
+				case 'Q': right = CastlingWhiteQueenside; break;
+				case 'k': right = CastlingBlackKingside; break;
+				case 'q': right = CastlingBlackQueenside; break;
+				default: return FenErrorCastling;
+			}
+			if (m_castling_rights & right)
+				return FenErrorCastling;
+			m_castling_rights |= right;
+		}
+	}
+
+	// Every right needs its king and rook still on their home squares
+	const struct {
+		std::uint8_t right;
+		Player player;
+		Square king;
+		Square rook;
+	} castling_homes[] = {
+		{ CastlingWhiteKingside, PlayerWhite, MakeSquare(4, 7), MakeSquare(7, 7) },
+		{ CastlingWhiteQueenside, PlayerWhite, MakeSquare(4, 7), MakeSquare(0, 7) },
+		{ CastlingBlackKingside, PlayerBlack, MakeSquare(4, 0), MakeSquare(7, 0) },
+		{ CastlingBlackQueenside, PlayerBlack, MakeSquare(4, 0), MakeSquare(0, 0) }
+	};
+	for (const auto &home : castling_homes) {
+		if ((m_castling_rights & home.right)
+			&& (GetPiece(home.king) != ChessPiece(home.player, PieceTypeKing) || GetPiece(home.rook) != ChessPiece(home.player, PieceTypeRook)))
+			return FenErrorCastling;
+	}
+
+	// The en passant square must be right behind a pawn that just double pushed
+	const std::string_view en_passant = next_fen_field(fen);
+	if (en_passant.size() == 2) {
+		if (en_passant[0] < 'a' || en_passant[0] > 'h' || en_passant[1] < '1' || en_passant[1] > '8')
+			return FenErrorEnPassant;
+
+		const Square target = MakeSquare(en_passant[0] - 'a', '8' - en_passant[1]);
+		const Player pusher = OpponentOf(m_side_to_move);
+		const std::size_t skipped_row = (pusher == PlayerWhite) ? 5 : 2;
+		const Square pawn = Square(target + PawnDirection(pusher) * 8);
+
+		if (SquareY(target) != skipped_row || (GetOccupancy() & SquareBit(target))
+			|| GetPiece(pawn) != ChessPiece(pusher, PieceTypePawn))
+			return FenErrorEnPassant;
+		m_en_passant = target;
+	} else if (en_passant != "-") {
+		return FenErrorEnPassant;
+	}
+
+	// The move counters are optional, but must come as a pair
+	const std::string_view halfmove = next_fen_field(fen);
+	const std::string_view fullmove = next_fen_field(fen);
+	if (!halfmove.empty()) {
+		unsigned halfmove_clock, fullmove_number;
+		if (!parse_fen_number(halfmove, halfmove_clock) || !parse_fen_number(fullmove, fullmove_number) || fullmove_number == 0)
+			return FenErrorMoveCounters;
+		m_halfmove_clock = static_cast<std::uint8_t>(std::min(halfmove_clock, 255u));
+		m_fullmove_number = static_cast<std::uint16_t>(std::min(fullmove_number, 65535u));
+	}
+
+	if (!next_fen_field(fen).empty())
+		return FenErrorTrailingText;
+
+	if (InCheck(OpponentOf(m_side_to_move)))
+		return FenErrorOpponentInCheck;
+
+	m_hash = ComputeHash();
+	return FenErrorNone;
+}
+
+std::optional<ChessBoard> ChessBoard::FromFEN(std::string_view fen, FenError *error)
+{
+	std::optional<ChessBoard> board(std::in_place);
+	const FenError result = board->LoadFEN(fen);
+
+	if (error)
+		*error = result;
+	if (result != FenErrorNone)
+		return std::nullopt;
+
+	return board;
+}
+
+static char *write_fen_number(char *out, unsigned value)
+{
+	char digits[5];
+	std::size_t count = 0;
+	do {
+		digits[count++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	} while (value);
+
+	while (count)
+		*out++ = digits[--count];
+	return out;
+}
+
+std::size_t ChessBoard::ToFEN(char *out) const
+{
+	char *p = out;
+
+	for (std::size_t y = 0; y < BOARD_HEIGHT; y++) {
+		std::size_t empty = 0;
+		for (std::size_t x = 0; x < BOARD_WIDTH; x++) {
+			const ChessPiece piece = GetPiece(MakeSquare(x, y));
+			if (!piece.IsValid()) {
+				empty++;
+				continue;
+			}
+			if (empty)
+				*p++ = static_cast<char>('0' + empty);
+			empty = 0;
+			*p++ = s_fen_piece_chars[piece.GetOwner()][piece.GetType()];
+		}
+		if (empty)
+			*p++ = static_cast<char>('0' + empty);
+		if (y + 1 < BOARD_HEIGHT)
+			*p++ = '/';
+	}
+
+	*p++ = ' ';
+	*p++ = (m_side_to_move == PlayerWhite) ? 'w' : 'b';
+
+	*p++ = ' ';
+	if (m_castling_rights == CastlingNone)
+		*p++ = '-';
+	if (m_castling_rights & CastlingWhiteKingside)
+		*p++ = 'K';
+	if (m_castling_rights & CastlingWhiteQueenside)
+		*p++ = 'Q';
+	if (m_castling_rights & CastlingBlackKingside)
+		*p++ = 'k';
+	if (m_castling_rights & CastlingBlackQueenside)
+		*p++ = 'q';
+
+	*p++ = ' ';
+	if (m_en_passant == SquareNone) {
+		*p++ = '-';
+	} else {
+		*p++ = static_cast<char>('a' + SquareX(m_en_passant));
+		*p++ = static_cast<char>('8' - SquareY(m_en_passant));
+	}
+
+	*p++ = ' ';
+	p = write_fen_number(p, m_halfmove_clock);
+	*p++ = ' ';
+	p = write_fen_number(p, m_fullmove_number);
+	*p = '\0';
+
+	assert(std::size_t(p - out) < FEN_BUFFER_SIZE);
+	return p - out;
+}
+
+HashKey ChessBoard::ComputeHash() const
+{
+	HashKey hash = Zobrist.castling[m_castling_rights] ^ ZobristEnPassant(m_en_passant);
+	if (m_side_to_move == PlayerBlack)
+		hash ^= Zobrist.black_to_move;
+
+	for (Square square = 0; square < 64; square++) {
+		const ChessPiece piece = GetPiece(square);
+		if (piece.IsValid())
+			hash ^= ZobristPiece(piece, square);
+	}
+
+	return hash;
+}
+
+void ChessBoard::PutPiece(Square square, ChessPiece piece)
+{
+	const Bitboard bit = SquareBit(square);
+
+	m_pieces[piece.GetType()] |= bit;
+	m_players[piece.GetOwner()] |= bit;
+}
+
+void ChessBoard::RemovePiece(Square square, ChessPiece piece)
+{
+	const Bitboard bit = SquareBit(square);
+
+	m_pieces[piece.GetType()] ^= bit;
+	m_players[piece.GetOwner()] ^= bit;
+}
+
+template <SlidingIndex Index>
+Bitboard ChessBoard::GetAttackersTo(Square square, Player player, Bitboard occupancy) const
+{
+	const Bitboard queens = GetPieces(player, PieceTypeQueen);
+
+	return (PawnAttacks(OpponentOf(player), square) & GetPieces(player, PieceTypePawn))
+		| (KnightAttacks(square) & GetPieces(player, PieceTypeKnight))
+		| (KingAttacks(square) & GetPieces(player, PieceTypeKing))
+		| (RookAttacks<Index>(square, occupancy) & (GetPieces(player, PieceTypeRook) | queens))
+		| (BishopAttacks<Index>(square, occupancy) & (GetPieces(player, PieceTypeBishop) | queens));
+}
+
+template <SlidingIndex Index>
+bool ChessBoard::IsSquareAttacked(Square square, Player byPlayer) const
+{
+	// Cheapest lookups first, so most answers skip the slider tables
+	if (PawnAttacks(OpponentOf(byPlayer), square) & GetPieces(byPlayer, PieceTypePawn))
+		return true;
+	if (KnightAttacks(square) & GetPieces(byPlayer, PieceTypeKnight))
+		return true;
+	if (KingAttacks(square) & GetPieces(byPlayer, PieceTypeKing))
+		return true;
+
+	const Bitboard occupancy = GetOccupancy();
+	const Bitboard queens = GetPieces(byPlayer, PieceTypeQueen);
+	return (BishopAttacks<Index>(square, occupancy) & (GetPieces(byPlayer, PieceTypeBishop) | queens))
+		|| (RookAttacks<Index>(square, occupancy) & (GetPieces(byPlayer, PieceTypeRook) | queens));
+}
+
+template <SlidingIndex Index>
+bool ChessBoard::InCheck(Player player) const
+{
+	const Bitboard king = GetPieces(player, PieceTypeKing);
+	return king && IsSquareAttacked<Index>(LowestSquare(king), OpponentOf(player));
+}
+
+bool ChessBoard::InCheck(Player player) const
+{
+	return WithSlidingIndex([&](auto index) { return InCheck<decltype(index)::value>(player); });
+}
+
+template Bitboard ChessBoard::GetAttackersTo<SlidingIndexMagic>(Square, Player, Bitboard) const;
+template Bitboard ChessBoard::GetAttackersTo<SlidingIndexPext>(Square, Player, Bitboard) const;
+template bool ChessBoard::InCheck<SlidingIndexMagic>(Player) const;
+template bool ChessBoard::InCheck<SlidingIndexPext>(Player) const;
+
+ChessPiece ChessBoard::GetPiece(Square square) const
+{
+	const Bitboard bit = SquareBit(square);
+
+	Player owner;
+	if (m_players[PlayerWhite] & bit)
+		owner = PlayerWhite;
+	else if (m_players[PlayerBlack] & bit)
+		owner = PlayerBlack;
+	else
+		return ChessPiece(PlayerNone, PieceTypeNone);
+
+	for (std::size_t type = PieceTypePawn; type < PieceTypeNone; type++) {
+		if (m_pieces[type] & bit)
+			return ChessPiece(owner, PieceType(type));
+	}
+
+	assert(false && "Occupied square has no piece type");
+	return ChessPiece(PlayerNone, PieceTypeNone);
+}
+
+// Where the rook starts and ends for a castling move
+static void castling_rook_squares(Move move, Square &rook_from, Square &rook_to)
+{
+	const Square king_to = move.To();
+
+	if (move.Flags() == MoveFlagKingCastle) {
+		rook_from = Square(king_to + 1);
+		rook_to = Square(king_to - 1);
+	} else {
+		rook_from = Square(king_to - 2);
+		rook_to = Square(king_to + 1);
+	}
+}
+
+// Square of the piece a move takes, which for en passant is not the
+// square the pawn lands on
+static Square capture_square(Move move)
+{
+	if (move.IsEnPassant())
+		return MakeSquare(SquareX(move.To()), SquareY(move.From()));
+
+	return move.To();
+}
+
+void ChessBoard::MakeMove(Move move, UndoEntry &undo)
+{
+	const Square from = move.From();
+	const Square to = move.To();
+	const Square taken = capture_square(move);
+	const ChessPiece piece = GetPiece(from);
+	const ChessPiece captured = GetPiece(taken);
+
+	undo.move = move;
+	undo.captured = captured;
+	undo.castling_rights = m_castling_rights;
+	undo.en_passant = m_en_passant;
+	undo.halfmove_clock = m_halfmove_clock;
+	undo.hash = m_hash;
+
+	HashKey hash = m_hash;
+
+	if (captured.IsValid()) {
+		RemovePiece(taken, captured);
+		hash ^= ZobristPiece(captured, taken);
+	}
+
+	const ChessPiece placed = move.IsPromotion() ? ChessPiece(piece.GetOwner(), move.PromotionType()) : piece;
+	RemovePiece(from, piece);
+	PutPiece(to, placed);
+	hash ^= ZobristPiece(piece, from) ^ ZobristPiece(placed, to);
+
+	if (move.IsCastle()) {
+		const ChessPiece rook(piece.GetOwner(), PieceTypeRook);
+		Square rook_from, rook_to;
+		castling_rook_squares(move, rook_from, rook_to);
+
+		RemovePiece(rook_from, rook);
+		PutPiece(rook_to, rook);
+		hash ^= ZobristPiece(rook, rook_from) ^ ZobristPiece(rook, rook_to);
+	}
+
+	if (captured.IsValid() || piece.GetType() == PieceTypePawn)
+		m_halfmove_clock = 0;
+	else
+		m_halfmove_clock++;
+
+	hash ^= ZobristEnPassant(m_en_passant) ^ Zobrist.castling[m_castling_rights];
+	m_en_passant = move.IsDoublePush() ? Square((from + to) / 2) : SquareNone;
+	m_castling_rights &= s_castling_rights_kept[from] & s_castling_rights_kept[to];
+	hash ^= ZobristEnPassant(m_en_passant) ^ Zobrist.castling[m_castling_rights];
+
+	if (m_side_to_move == PlayerBlack)
+		m_fullmove_number++;
+	m_side_to_move = OpponentOf(m_side_to_move);
+	m_hash = hash ^ Zobrist.black_to_move;
+}
+
+void ChessBoard::UnmakeMove(const UndoEntry &undo)
 {
-	return m_board[loc.y][loc.x];
-}
\ No newline at end of file
+	const Move move = undo.move;
+	const Square from = move.From();
+	const Square to = move.To();
+	const ChessPiece placed = GetPiece(to);
+
+	RemovePiece(to, placed);
+	PutPiece(from, move.IsPromotion() ? ChessPiece(placed.GetOwner(), PieceTypePawn) : placed);
+	if (undo.captured.IsValid())
+		PutPiece(capture_square(move), undo.captured);
+
+	if (move.IsCastle()) {
+		const ChessPiece rook(placed.GetOwner(), PieceTypeRook);
+		Square rook_from, rook_to;
+		castling_rook_squares(move, rook_from, rook_to);
+
+		RemovePiece(rook_to, rook);
+		PutPiece(rook_from, rook);
+	}
+
+	m_castling_rights = undo.castling_rights;
+	m_en_passant = undo.en_passant;
+	m_halfmove_clock = undo.halfmove_clock;
+	m_hash = undo.hash;
+	m_side_to_move = OpponentOf(m_side_to_move);
+	if (m_side_to_move == PlayerBlack)
+		m_fullmove_number--;
+}
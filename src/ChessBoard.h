@@ -1,16 +1,24 @@
 #ifndef CHESSBOARD_INCLUDE_H
 #define CHESSBOARD_INCLUDE_H
+#include "Bitboard.h"
 #include "ChessPiece.h"
+#include "Move.h"
+#include "Zobrist.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <optional>
+#include <string_view>
+
+// Declared in Attacks.h
+enum SlidingIndex : std::uint8_t;
 
 // Described with the top left tile as the origin,
 // and the x-axis increasing as it moves to the right,
 // and the y-axis increasing as it moves down
 struct ChessPieceLocation {
-	std::size_t x;
-	std::size_t y;
+	std::uint8_t x;
+	std::uint8_t y;
 
 	ChessPieceLocation(std::size_t x, std::size_t y) : x(x), y(y) {
 		assert(CanCreateLocation(x, y) && "Invalid location");
@@ -19,112 +27,147 @@ struct ChessPieceLocation {
 	bool operator==(const ChessPieceLocation &other) const {
 		return (x == other.x) && (y == other.y);
 	}
-	
+
+	Square ToSquare() const {
+		return MakeSquare(x, y);
+	}
+
 	constexpr static bool CanCreateLocation(std::size_t x, std::size_t y) {
 		return (x <= 7) && (y <= 7);
 	}
+};
 
-	static std::optional<ChessPieceLocation> CreateLocationIfPossible(std::size_t x, std::size_t y) {
-		if (CanCreateLocation(x, y))
-			return ChessPieceLocation(x, y);
-		
-		return std::nullopt;
-	}
+// One bit for each king and rook pair that may still castle
+enum CastlingRights : std::uint8_t {
+	CastlingNone = 0,
+	CastlingWhiteKingside = 1,
+	CastlingWhiteQueenside = 2,
+	CastlingBlackKingside = 4,
+	CastlingBlackQueenside = 8,
+	CastlingAll = 15
 };
 
+// Everything MakeMove overwrites that can't be worked out from the move
+// itself. The caller keeps it and hands it back to UnmakeMove, so the
+// board stays a small value that is cheap to copy.
+struct UndoEntry {
+	Move move;
+	ChessPiece captured;
+	std::uint8_t castling_rights;
+	Square en_passant;
+	std::uint8_t halfmove_clock;
+	HashKey hash;
+};
+
+// Why a FEN string was rejected
+enum FenError : std::uint8_t {
+	FenErrorNone = 0,
+	FenErrorPlacement,
+	FenErrorKings,
+	FenErrorPawnRow,
+	FenErrorSideToMove,
+	FenErrorCastling,
+	FenErrorEnPassant,
+	FenErrorMoveCounters,
+	FenErrorOpponentInCheck,
+	FenErrorTrailingText
+};
+
+const char *FenErrorString(FenError error);
+
+// True when the last of count position hashes, the current position,
+// already occurred among the ones before it since the last capture or
+// pawn move. hashes run from the oldest position to the current one.
+inline bool IsRepetition(const HashKey *hashes, std::size_t count, std::uint8_t halfmove_clock)
+{
+	if (count == 0)
+		return false;
+
+	const std::size_t reversible = std::min<std::size_t>(halfmove_clock, count - 1);
+	const HashKey current = hashes[count - 1];
+
+	// Only positions with the same side to move can match
+	for (std::size_t back = 4; back <= reversible; back += 2) {
+		if (hashes[count - 1 - back] == current)
+			return true;
+	}
+	return false;
+}
+
 class ChessBoard {
+public:
+	// Room ToFEN needs, including the terminating null
+	static constexpr std::size_t FEN_BUFFER_SIZE = 96;
 private:
 	static constexpr std::size_t BOARD_WIDTH = 8;
 	static constexpr std::size_t BOARD_HEIGHT = 8;
 
-	ChessPiece m_board[BOARD_WIDTH][BOARD_HEIGHT] = {
-		{
-			ChessPiece(PlayerBlack, PieceTypeRook),
-			ChessPiece(PlayerBlack, PieceTypeKnight),
-			ChessPiece(PlayerBlack, PieceTypeBishop),
-			ChessPiece(PlayerBlack, PieceTypeQueen),
-			ChessPiece(PlayerBlack, PieceTypeKing),
-			ChessPiece(PlayerBlack, PieceTypeBishop),
-			ChessPiece(PlayerBlack, PieceTypeKnight),
-			ChessPiece(PlayerBlack, PieceTypeRook)
-		},
-		{
-			ChessPiece(PlayerBlack, PieceTypePawn),
-			ChessPiece(PlayerBlack, PieceTypePawn),
-			ChessPiece(PlayerBlack, PieceTypePawn),
-			ChessPiece(PlayerBlack, PieceTypePawn),
-			ChessPiece(PlayerBlack, PieceTypePawn),
-			ChessPiece(PlayerBlack, PieceTypePawn),
-			ChessPiece(PlayerBlack, PieceTypePawn),
-			ChessPiece(PlayerBlack, PieceTypePawn)
-		},
-		{
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone)
-		},
-		{
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone)
-		},
-		{
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone)
-		},
-		{
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone),
-			ChessPiece(PlayerNone, PieceTypeNone)
-		},
-		{
-			ChessPiece(PlayerWhite, PieceTypePawn),
-			ChessPiece(PlayerWhite, PieceTypePawn),
-			ChessPiece(PlayerWhite, PieceTypePawn),
-			ChessPiece(PlayerWhite, PieceTypePawn),
-			ChessPiece(PlayerWhite, PieceTypePawn),
-			ChessPiece(PlayerWhite, PieceTypePawn),
-			ChessPiece(PlayerWhite, PieceTypePawn),
-			ChessPiece(PlayerWhite, PieceTypePawn)
-		},
-		{
-			ChessPiece(PlayerWhite, PieceTypeRook),
-			ChessPiece(PlayerWhite, PieceTypeKnight),
-			ChessPiece(PlayerWhite, PieceTypeBishop),
-			ChessPiece(PlayerWhite, PieceTypeQueen),
-			ChessPiece(PlayerWhite, PieceTypeKing),
-			ChessPiece(PlayerWhite, PieceTypeBishop),
-			ChessPiece(PlayerWhite, PieceTypeKnight),
-			ChessPiece(PlayerWhite, PieceTypeRook)
-		}
-	};
+	// One set per piece type and one per player; the pieces of a given
+	// player and type are the intersection of the two
+	Bitboard m_pieces[PieceTypeNone] = {};
+	Bitboard m_players[PlayerNone] = {};
+
+	Player m_side_to_move = PlayerWhite;
+	std::uint8_t m_castling_rights = CastlingAll;
+	// Square a pawn skipped over with a double push on the last move
+	Square m_en_passant = SquareNone;
+	std::uint8_t m_halfmove_clock = 0;
+	std::uint16_t m_fullmove_number = 1;
+
+	// Zobrist key of the position, kept up to date by every move
+	HashKey m_hash = 0;
+
+	void PutPiece(Square square, ChessPiece piece);
+	void RemovePiece(Square square, ChessPiece piece);
+	HashKey ComputeHash() const;
+	void Clear();
 public:
-	bool MovePiece(ChessPieceLocation from, ChessPieceLocation to);
-	const ChessPiece &GetPiece(ChessPieceLocation loc) const;
+	ChessBoard();
+
+	// Replaces the position with the one described by a FEN string, which
+	// must describe a position that can arise in a game. Nothing is
+	// allocated and nothing is thrown, so it is cheap to call in a loop on
+	// one board. On failure the board is left in an unspecified state.
+	FenError LoadFEN(std::string_view fen);
+	static std::optional<ChessBoard> FromFEN(std::string_view fen, FenError *error = nullptr);
+
+	// Writes the position as a null terminated FEN string to out, which
+	// needs FEN_BUFFER_SIZE chars. Returns the length written.
+	std::size_t ToFEN(char *out) const;
+
+	ChessPiece GetPiece(Square square) const;
+
+	// MakeMove trusts the move to be one generated for this position, and
+	// fills undo with what UnmakeMove needs to take it back. Moves must be
+	// unmade in the reverse order they were made.
+	void MakeMove(Move move, UndoEntry &undo);
+	void UnmakeMove(const UndoEntry &undo);
+
+	// Pieces of player attacking square, looked up from the square outwards
+	// rather than by generating the player's moves. Sliders are blocked by
+	// the given occupancy. Index must be ActiveSlidingIndex().
+	template <SlidingIndex Index>
+	Bitboard GetAttackersTo(Square square, Player player, Bitboard occupancy) const;
+	template <SlidingIndex Index>
+	bool IsSquareAttacked(Square square, Player byPlayer) const;
+	template <SlidingIndex Index>
+	bool InCheck(Player player) const;
+	// Picks the sliding index itself, for code off the hot paths
+	bool InCheck(Player player) const;
+
+	Bitboard GetPieces(Player player, PieceType type) const { return m_pieces[type] & m_players[player]; }
+	Bitboard GetPlayerPieces(Player player) const { return m_players[player]; }
+	Bitboard GetOccupancy() const { return m_players[PlayerWhite] | m_players[PlayerBlack]; }
+
+	Player GetSideToMove() const { return m_side_to_move; }
+	std::uint8_t GetCastlingRights() const { return m_castling_rights; }
+	Square GetEnPassantSquare() const { return m_en_passant; }
+	std::uint8_t GetHalfmoveClock() const { return m_halfmove_clock; }
+	std::uint16_t GetFullmoveNumber() const { return m_fullmove_number; }
+	HashKey GetHash() const { return m_hash; }
 
 	std::size_t GetWidth() const { return BOARD_WIDTH; }
 	std::size_t GetHeight() const { return BOARD_HEIGHT; }
 };
 
-#endif // CHESSBOARD_INCLUDE_H
\ No newline at end of file
+#endif // CHESSBOARD_INCLUDE_H
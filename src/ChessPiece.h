@@ -1,14 +1,15 @@
 #ifndef CHESSPIECE_INCLUDE_H
 #define CHESSPIECE_INCLUDE_H
 #include <cstddef>
+#include <cstdint>
 
-enum Player : std::size_t {
+enum Player : std::uint8_t {
 	PlayerWhite = 0,
 	PlayerBlack = 1,
 	PlayerNone = 2
 };
  
-enum PieceType : std::size_t {
+enum PieceType : std::uint8_t {
 	PieceTypePawn = 0,
 	PieceTypeRook = 1,
 	PieceTypeKnight = 2,
@@ -18,23 +19,38 @@ enum PieceType : std::size_t {
 	PieceTypeNone = 6
 };
 
+constexpr Player OpponentOf(Player player)
+{
+	return Player(player ^ 1);
+}
+
+// A piece packed into one byte, owner in the high nibble and type in the
+// low nibble. Anything that depends on the history of the game (castling,
+// en passant) is tracked by the ChessBoard rather than the piece.
 class ChessPiece {
 private:
-	Player owner;
-	PieceType type;
-
-	std::size_t moveCount;
+	std::uint8_t m_code;
 public:
-	ChessPiece(Player p, PieceType t);
+	ChessPiece() = default;
+	constexpr ChessPiece(Player p, PieceType t)
+		: m_code(static_cast<std::uint8_t>((p << 4) | t))
+	{
+	}
 
-	Player GetOwner() const;
-	PieceType GetType() const;
+	constexpr Player GetOwner() const { return Player(m_code >> 4); }
+	constexpr PieceType GetType() const { return PieceType(m_code & 0xF); }
 
-	bool IsValid() const;
-	bool IsFriendly(const ChessPiece &other) const;
-	
-	void IncrementMoveCount();
-	std::size_t GetMoveCount() const;
+	constexpr bool IsValid() const {
+		return (GetOwner() != PlayerNone) && (GetType() != PieceTypeNone);
+	}
+	constexpr bool IsFriendly(const ChessPiece &other) const {
+		return GetOwner() == other.GetOwner();
+	}
+
+	constexpr bool operator==(const ChessPiece &other) const { return m_code == other.m_code; }
+	constexpr bool operator!=(const ChessPiece &other) const { return m_code != other.m_code; }
 };
 
-#endif // CHESSPIECE_INCLUDE_H
\ No newline at end of file
+static_assert(sizeof(ChessPiece) == 1, "ChessPiece must stay one byte");
+
+#endif // CHESSPIECE_INCLUDE_H
@@ -0,0 +1,38 @@
+#include "CommandLine.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+bool ParseCommandOption(int argc, char *argv[], int &i, CommandOptions &options)
+{
+	if (i + 1 >= argc)
+		return false;
+
+	if (std::strcmp(argv[i], "--threads") == 0)
+		options.thread_count = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+	else if (std::strcmp(argv[i], "--hash") == 0)
+		options.hash_megabytes = std::strtoul(argv[++i], nullptr, 10);
+	else
+		return false;
+
+	return true;
+}
+
+bool LoadCommandFEN(const char *command, const std::vector<const char *> &args, std::size_t first, ChessBoard &board)
+{
+	std::string fen;
+	for (std::size_t i = first; i < args.size(); i++) {
+		if (i > first)
+			fen += ' ';
+		fen += args[i];
+	}
+
+	const FenError error = fen.empty() ? FenErrorNone : board.LoadFEN(fen);
+	if (error != FenErrorNone) {
+		std::fprintf(stderr, "%s: invalid FEN \"%s\": %s\n", command, fen.c_str(), FenErrorString(error));
+		return false;
+	}
+	return true;
+}
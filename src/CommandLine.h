@@ -0,0 +1,23 @@
+#ifndef COMMANDLINE_INCLUDE_H
+#define COMMANDLINE_INCLUDE_H
+#include "ChessBoard.h"
+#include <cstddef>
+#include <vector>
+
+// Options every headless command takes
+struct CommandOptions {
+	std::size_t thread_count;
+	std::size_t hash_megabytes;
+};
+
+// Takes "--threads N" or "--hash MB" at argv[i], stepping i over the
+// value. Returns false, leaving i alone, for any other argument. The
+// thread count is never set below one.
+bool ParseCommandOption(int argc, char *argv[], int &i, CommandOptions &options);
+
+// Loads the FEN in args[first] onwards into board, leaving the starting
+// position if there is none. The FEN may arrive quoted or split over
+// several arguments. Errors are reported on stderr under command's name.
+bool LoadCommandFEN(const char *command, const std::vector<const char *> &args, std::size_t first, ChessBoard &board);
+
+#endif // COMMANDLINE_INCLUDE_H
@@ -0,0 +1,20 @@
+#ifndef EMBEDDEDASSETS_INCLUDE_H
+#define EMBEDDEDASSETS_INCLUDE_H
+#include <cstddef>
+
+// A file from the assets directory compiled into the executable.
+// EmbeddedAssets.cpp is generated by tools/embed_assets.py.
+struct EmbeddedAsset {
+	const char *name;
+	const unsigned char *data;
+	std::size_t size;
+};
+
+extern const EmbeddedAsset EmbeddedAssets[];
+extern const std::size_t EmbeddedAssetCount;
+
+// Looks an asset up by its file name, such as "PawnW.png". Returns null
+// if there is no such asset.
+const EmbeddedAsset *FindEmbeddedAsset(const char *name);
+
+#endif // EMBEDDEDASSETS_INCLUDE_H
@@ -0,0 +1,118 @@
+#include "Engine.h"
+#include <algorithm>
+
+Engine::Engine(std::size_t hash_megabytes, std::size_t thread_count, std::function<void()> on_result)
+	: m_table(hash_megabytes, thread_count), m_search(m_table, thread_count), m_on_result(std::move(on_result))
+{
+	m_thread = std::thread(&Engine::thread_main, this);
+}
+
+Engine::~Engine()
+{
+	m_quitting.store(true);
+	Stop();
+
+	EngineCommand command = {};
+	command.type = EngineCommandQuit;
+	push_command(command);
+
+	m_thread.join();
+}
+
+void Engine::push_command(const EngineCommand &command)
+{
+	// The engine thread drains commands between searches, and a search
+	// is stopped first when quitting, so a full queue clears quickly
+	while (!m_commands.TryPush(command))
+		std::this_thread::yield();
+
+	// Taking the mutex, held by the engine thread only while it checks
+	// for work, makes sure the wake up can't slip in before it sleeps
+	{
+		std::lock_guard<std::mutex> lock(m_wake_mutex);
+	}
+	m_wake.notify_one();
+}
+
+void Engine::push_result(const EngineResult &result, bool must_arrive)
+{
+	// Progress reports are dropped if the UI falls behind, best moves
+	// wait for room
+	while (!m_results.TryPush(result)) {
+		if (!must_arrive || m_quitting.load())
+			return;
+		std::this_thread::yield();
+	}
+
+	if (m_on_result)
+		m_on_result();
+}
+
+std::uint32_t Engine::StartSearch(const ChessBoard &board, const HashKey *history, std::size_t history_size, const SearchLimits &limits)
+{
+	EngineCommand command = {};
+	command.type = EngineCommandSearch;
+	command.id = m_next_id++;
+	command.board = board;
+	command.limits = limits;
+
+	// Older positions can't be repeated any more
+	const std::size_t kept = std::min(history_size, EngineCommand::HISTORY_SIZE);
+	std::copy(history + history_size - kept, history + history_size, command.history);
+	command.history_size = kept;
+
+	push_command(command);
+	return command.id;
+}
+
+void Engine::Stop()
+{
+	// The id goes first: a search that starts after clearing the flag
+	// is sure to see it and not start at all
+	m_stopped_id.store(m_next_id - 1);
+	m_stop.store(true);
+}
+
+void Engine::run_search(const EngineCommand &command)
+{
+	m_stop.store(false);
+	if (command.id <= m_stopped_id.load())
+		return;
+
+	EngineResult result = {};
+	result.id = command.id;
+	result.hash = command.board.GetHash();
+
+	SearchLimits limits = command.limits;
+	limits.stop = &m_stop;
+
+	result.type = EngineResultInfo;
+	result.info = m_search.Search(command.board, command.history, command.history_size, limits, [this, &result](const SearchInfo &info) {
+		result.info = info;
+		push_result(result, false);
+	});
+
+	result.type = EngineResultBestMove;
+	push_result(result, true);
+}
+
+void Engine::thread_main()
+{
+	while (true) {
+		EngineCommand command;
+		{
+			std::unique_lock<std::mutex> lock(m_wake_mutex);
+			m_wake.wait(lock, [this]() { return !m_commands.Empty(); });
+		}
+
+		while (m_commands.TryPop(command)) {
+			switch (command.type) {
+				case EngineCommandSearch:
+					run_search(command);
+					break;
+				case EngineCommandQuit:
+					return;
+			}
+		}
+	}
+}
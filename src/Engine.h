@@ -0,0 +1,106 @@
+#ifndef ENGINE_INCLUDE_H
+#define ENGINE_INCLUDE_H
+#include "ChessBoard.h"
+#include "Search.h"
+#include "SpscQueue.h"
+#include "TranspositionTable.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+enum EngineCommandType : std::uint8_t {
+	EngineCommandSearch,
+	EngineCommandQuit
+};
+
+struct EngineCommand {
+	// A position can only repeat one reached since the last capture or
+	// pawn move, and the fifty move rule ends the game 100 plies after
+	static constexpr std::size_t HISTORY_SIZE = 100;
+
+	EngineCommandType type;
+	std::uint32_t id;
+	ChessBoard board;
+	// Hashes of the positions played before board, oldest first, so the
+	// search can tell when it repeats one of them
+	HashKey history[HISTORY_SIZE];
+	std::size_t history_size;
+	SearchLimits limits;
+};
+
+enum EngineResultType : std::uint8_t {
+	EngineResultInfo,
+	EngineResultBestMove
+};
+
+struct EngineResult {
+	EngineResultType type;
+	// Id of the search command this answers
+	std::uint32_t id;
+	// Hash of the searched position, to spot answers for a board that
+	// has changed since
+	HashKey hash;
+	SearchInfo info;
+};
+
+// Runs searches on a thread of its own so the UI thread never waits on
+// one. Commands go in and results come out through lock-free single
+// producer, single consumer queues; the UI thread is the only producer
+// of commands and the only consumer of results. Stopping a search is a
+// single atomic store. The engine thread sleeps while it has nothing to
+// do, and only it ever waits on the wake up mutex for any length of time.
+class Engine {
+public:
+	static constexpr std::size_t COMMAND_QUEUE_SIZE = 16;
+	static constexpr std::size_t RESULT_QUEUE_SIZE = 64;
+private:
+	TranspositionTable m_table;
+	SmpSearch m_search;
+
+	SpscQueue<EngineCommand, COMMAND_QUEUE_SIZE> m_commands;
+	SpscQueue<EngineResult, RESULT_QUEUE_SIZE> m_results;
+
+	std::atomic<bool> m_stop{ false };
+	// Searches with an id up to this one are stopped or never started
+	std::atomic<std::uint32_t> m_stopped_id{ 0 };
+	std::uint32_t m_next_id = 1;
+	// Set once the UI stops reading results, so nothing waits on them
+	std::atomic<bool> m_quitting{ false };
+
+	// Called on the engine thread after each result is queued
+	std::function<void()> m_on_result;
+
+	std::mutex m_wake_mutex;
+	std::condition_variable m_wake;
+	std::thread m_thread;
+
+	void push_command(const EngineCommand &command);
+	void push_result(const EngineResult &result, bool must_arrive);
+	void run_search(const EngineCommand &command);
+	void thread_main();
+public:
+	// on_result, if given, is called on the engine thread whenever a
+	// result is queued, so a UI waiting on events can be woken up
+	Engine(std::size_t hash_megabytes, std::size_t thread_count, std::function<void()> on_result = nullptr);
+	~Engine();
+
+	Engine(const Engine &) = delete;
+	Engine &operator=(const Engine &) = delete;
+
+	// Starts searching board once any earlier command is done. history
+	// holds the hashes of the positions played before it, oldest first.
+	// Returns the id its results will carry.
+	std::uint32_t StartSearch(const ChessBoard &board, const HashKey *history, std::size_t history_size, const SearchLimits &limits);
+
+	// Stops the running search and drops any queued ones. A stopped
+	// search still answers with the best move it had.
+	void Stop();
+
+	// Takes the next result, if any. Never blocks.
+	bool PollResult(EngineResult &result) { return m_results.TryPop(result); }
+};
+
+#endif // ENGINE_INCLUDE_H
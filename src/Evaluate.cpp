@@ -0,0 +1,123 @@
+#include "Evaluate.h"
+#include <algorithm>
+
+// Piece-square tables from White's point of view, laid out like the board
+// with the black back row (y = 0) first. Black looks them up mirrored.
+static const int s_pawn_table[64] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	 50,  50,  50,  50,  50,  50,  50,  50,
+	 10,  10,  20,  30,  30,  20,  10,  10,
+	  5,   5,  10,  25,  25,  10,   5,   5,
+	  0,   0,   0,  20,  20,   0,   0,   0,
+	  5,  -5, -10,   0,   0, -10,  -5,   5,
+	  5,  10,  10, -20, -20,  10,  10,   5,
+	  0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static const int s_rook_table[64] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	  5,  10,  10,  10,  10,  10,  10,   5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	  0,   0,   0,   5,   5,   0,   0,   0
+};
+
+static const int s_knight_table[64] = {
+	-50, -40, -30, -30, -30, -30, -40, -50,
+	-40, -20,   0,   0,   0,   0, -20, -40,
+	-30,   0,  10,  15,  15,  10,   0, -30,
+	-30,   5,  15,  20,  20,  15,   5, -30,
+	-30,   0,  15,  20,  20,  15,   0, -30,
+	-30,   5,  10,  15,  15,  10,   5, -30,
+	-40, -20,   0,   5,   5,   0, -20, -40,
+	-50, -40, -30, -30, -30, -30, -40, -50
+};
+
+static const int s_bishop_table[64] = {
+	-20, -10, -10, -10, -10, -10, -10, -20,
+	-10,   0,   0,   0,   0,   0,   0, -10,
+	-10,   0,   5,  10,  10,   5,   0, -10,
+	-10,   5,   5,  10,  10,   5,   5, -10,
+	-10,   0,  10,  10,  10,  10,   0, -10,
+	-10,  10,  10,  10,  10,  10,  10, -10,
+	-10,   5,   0,   0,   0,   0,   5, -10,
+	-20, -10, -10, -10, -10, -10, -10, -20
+};
+
+static const int s_queen_table[64] = {
+	-20, -10, -10,  -5,  -5, -10, -10, -20,
+	-10,   0,   0,   0,   0,   0,   0, -10,
+	-10,   0,   5,   5,   5,   5,   0, -10,
+	 -5,   0,   5,   5,   5,   5,   0,  -5,
+	  0,   0,   5,   5,   5,   5,   0,  -5,
+	-10,   5,   5,   5,   5,   5,   0, -10,
+	-10,   0,   5,   0,   0,   0,   0, -10,
+	-20, -10, -10,  -5,  -5, -10, -10, -20
+};
+
+static const int s_king_middlegame_table[64] = {
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-20, -30, -30, -40, -40, -30, -30, -20,
+	-10, -20, -20, -20, -20, -20, -20, -10,
+	 20,  20,   0,   0,   0,   0,  20,  20,
+	 20,  30,  10,   0,   0,  10,  30,  20
+};
+
+static const int s_king_endgame_table[64] = {
+	-50, -40, -30, -20, -20, -30, -40, -50,
+	-30, -20, -10,   0,   0, -10, -20, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -30,   0,   0,   0,   0, -30, -30,
+	-50, -30, -30, -30, -30, -30, -30, -50
+};
+
+static const int *const s_piece_tables[PieceTypeKing] = {
+	s_pawn_table, s_rook_table, s_knight_table, s_bishop_table, s_queen_table
+};
+
+// Non-pawn material at which the king is treated as fully in the middlegame
+static constexpr int PHASE_MATERIAL = 2 * (2 * 500 + 2 * 320 + 2 * 330 + 900);
+
+// Mirrors a square vertically so Black can use White's tables
+static inline Square relative_square(Player player, Square square)
+{
+	return (player == PlayerWhite) ? square : Square(square ^ 56);
+}
+
+int Evaluate(const ChessBoard &board)
+{
+	int score[PlayerNone] = {};
+	int phase_material = 0;
+
+	for (std::size_t player = PlayerWhite; player < PlayerNone; player++) {
+		for (std::size_t type = PieceTypePawn; type < PieceTypeKing; type++) {
+			Bitboard pieces = board.GetPieces(Player(player), PieceType(type));
+			const int count = PopCount(pieces);
+
+			score[player] += count * PieceValues[type];
+			if (type != PieceTypePawn)
+				phase_material += count * PieceValues[type];
+
+			while (pieces)
+				score[player] += s_piece_tables[type][relative_square(Player(player), PopLowestSquare(pieces))];
+		}
+	}
+
+	const int phase = std::min(phase_material, PHASE_MATERIAL);
+	for (std::size_t player = PlayerWhite; player < PlayerNone; player++) {
+		const Square king = relative_square(Player(player), LowestSquare(board.GetPieces(Player(player), PieceTypeKing)));
+		score[player] += (s_king_middlegame_table[king] * phase + s_king_endgame_table[king] * (PHASE_MATERIAL - phase)) / PHASE_MATERIAL;
+	}
+
+	const Player us = board.GetSideToMove();
+	return score[us] - score[OpponentOf(us)];
+}
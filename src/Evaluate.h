@@ -0,0 +1,13 @@
+#ifndef EVALUATE_INCLUDE_H
+#define EVALUATE_INCLUDE_H
+#include "ChessBoard.h"
+
+// Material value of each piece type in centipawns, indexed by PieceType
+inline constexpr int PieceValues[PieceTypeNone] = { 100, 500, 320, 330, 900, 0 };
+
+// Static score of the position in centipawns from the point of view of
+// the side to move: material plus piece-square bonuses. The king's table
+// fades from the middlegame one to the endgame one as pieces come off.
+int Evaluate(const ChessBoard &board);
+
+#endif // EVALUATE_INCLUDE_H
@@ -1,4 +1,7 @@
 #include "Game.h"
+#include "EmbeddedAssets.h"
+#include "MoveGen.h"
+#include "SpriteScale.h"
 
 static inline SDL_Rect SDLRectMake(unsigned x, unsigned y, unsigned w, unsigned h)
 {
@@ -11,10 +14,11 @@ static inline SDL_Rect SDLRectMake(unsigned x, unsigned y, unsigned w, unsigned
 	return r;
 }
 
-static std::string GetAssetPath(const char *in)
-{
-	return std::string("assets/") + in;
-}
+// 't' cycles through these
+static const BoardTheme s_board_themes[] = {
+	{ { 224, 195, 157, 255 }, { 92, 76, 56, 255 }, { 109, 219, 252, 255 }, { 205, 210, 106, 160 }, { 230, 40, 40, 170 } },
+	{ { 222, 227, 230, 255 }, { 140, 162, 173, 255 }, { 246, 214, 104, 255 }, { 130, 190, 120, 160 }, { 230, 40, 40, 170 } }
+};
 
 ChessGame::ChessGame(int argc, char *argv[])
 {
@@ -22,6 +26,19 @@ ChessGame::ChessGame(int argc, char *argv[])
 		auto str = std::string(argv[i]);
 		m_args.push_back(str);
 	}
+
+	// "--engine white|black|none" picks the side the computer plays
+	for (std::size_t i = 1; i + 1 < m_args.size(); i++) {
+		if (m_args[i] != "--engine")
+			continue;
+
+		if (m_args[i + 1] == "white")
+			m_engine_player = PlayerWhite;
+		else if (m_args[i + 1] == "black")
+			m_engine_player = PlayerBlack;
+		else
+			m_engine_player = PlayerNone;
+	}
 }
 
 void ChessGame::setup_libraries()
@@ -43,21 +60,63 @@ void ChessGame::setup()
 		SDL_WINDOWPOS_UNDEFINED, 
 		window_width, 
 		window_height, 
-		0
+		SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI
 	);
 	if (!m_main_window)
 		throw std::runtime_error("Game window could not be created.");
 
+	// Queues render commands instead of sending each one straight away.
+	// SDL 2.0.10 and later already do this when the app leaves the render
+	// driver to SDL, so the hint only matters if a driver is forced.
+	SDL_SetHint(SDL_HINT_RENDER_BATCHING, "1");
+
 	m_main_renderer = SDL_CreateRenderer(m_main_window, -1, SDL_RENDERER_ACCELERATED);
 	if (!m_main_renderer)
 		throw std::runtime_error("Game renderer could not be created.");
 
 	SDL_SetRenderDrawBlendMode(m_main_renderer, SDL_BLENDMODE_BLEND);
 
-	load_piece_textures(m_piece_textures);
+	load_piece_atlas();
+	update_layout();
+
+	if (m_engine_player != PlayerNone) {
+		// Leave one core for this thread
+		const std::size_t cores = std::thread::hardware_concurrency();
+		m_engine_event = SDL_RegisterEvents(1);
+		const std::uint32_t engine_event = m_engine_event;
+
+		// SDL_PushEvent is safe to call from the engine thread
+		m_engine.reset(new Engine(engine_hash_megabytes, (cores > 1) ? cores - 1 : 1, [engine_event]() {
+			SDL_Event e = {};
+			e.type = engine_event;
+			SDL_PushEvent(&e);
+		}));
+		start_engine_move();
+	}
+}
+
+// Decodes an embedded PNG into an RGBA32 surface. Touches no renderer or
+// window state, so it is safe to run on any thread.
+static SDL_Surface *decode_embedded_image(const char *name)
+{
+	const EmbeddedAsset *asset = FindEmbeddedAsset(name);
+	if (!asset)
+		return nullptr;
+
+	SDL_RWops *rw = SDL_RWFromConstMem(asset->data, int(asset->size));
+	SDL_Surface *decoded = rw ? IMG_Load_RW(rw, 1) : nullptr;
+	if (!decoded)
+		return nullptr;
+
+	SDL_Surface *converted = SDL_ConvertSurfaceFormat(decoded, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(decoded);
+	return converted;
 }
 
-void ChessGame::load_piece_textures(std::array<SDL_Texture *, 12> &texts)
+// Packs the 12 sprites into a single sheet. Textures are made from it
+// once per tile size by select_piece_atlas, on this thread, since only
+// the thread owning the renderer may create them.
+void ChessGame::load_piece_atlas()
 {
 	const std::array<const char *, 12> urls = {
 		"PawnW.png", "RookW.png",
@@ -68,479 +127,484 @@ void ChessGame::load_piece_textures(std::array<SDL_Texture *, 12> &texts)
 		"QueenB.png", "KingB.png"
 	};
 
-	for (std::size_t i = 0; i < urls.size(); i++) {
-		const char *url = urls[i];
-		auto assetPath = GetAssetPath(url);
+	// The images are compiled in, so decoding is all the work there is
+	// and it is spread over worker threads
+	std::array<SDL_Surface *, 12> surfaces = {};
+	std::atomic<std::size_t> next_image{ 0 };
 
-		SDL_Texture *texture = IMG_LoadTexture(m_main_renderer, assetPath.c_str());
-		if (!texture)
-			throw std::runtime_error("Failed to load texture!");
-			
-		texts[i] = texture;
-	}
-}
+	auto decode_images = [&]() {
+		for (std::size_t i; (i = next_image.fetch_add(1)) < urls.size();)
+			surfaces[i] = decode_embedded_image(urls[i]);
+	};
 
-void ChessGame::draw_board()
-{
-	for (std::size_t y = 0; y < m_board.GetHeight(); y++) {
-		for (std::size_t x = 0; x < m_board.GetWidth(); x++) {
-			const SDL_Rect tileRect = SDLRectMake(
-				x * tile_width, y * tile_height, 
-				tile_width, tile_height
-			);
+	const std::size_t worker_count = std::min<std::size_t>(urls.size(), std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::thread> workers;
+	for (std::size_t i = 1; i < worker_count; i++)
+		workers.emplace_back(decode_images);
 
-			// draw checkerboard pattern
-			if ((x % 2 == 0) ^ (y % 2 == 0))
-				SDL_SetRenderDrawColor(m_main_renderer, 92, 76, 56, 255);
-			else
-				SDL_SetRenderDrawColor(m_main_renderer, 224, 195, 157, 255);
+	decode_images();
+	for (std::thread &worker : workers)
+		worker.join();
+
+	auto free_surfaces = [&surfaces]() {
+		for (SDL_Surface *surface : surfaces)
+			SDL_FreeSurface(surface);
+	};
 
-			SDL_RenderFillRect(m_main_renderer, &tileRect);
+	for (SDL_Surface *surface : surfaces) {
+		if (!surface) {
+			free_surfaces();
+			throw std::runtime_error("Failed to load texture!");
 		}
 	}
+
+	// The first sprite decides the size of every cell
+	const int cell_width = surfaces[0]->w;
+	const int cell_height = surfaces[0]->h;
+	m_piece_sheet = SDL_CreateRGBSurfaceWithFormat(0, cell_width * PieceTypeNone,
+		cell_height * PlayerNone, 32, SDL_PIXELFORMAT_RGBA32);
+	if (!m_piece_sheet) {
+		free_surfaces();
+		throw std::runtime_error("Failed to create the piece atlas!");
+	}
+
+	for (std::size_t i = 0; i < surfaces.size(); i++) {
+		// Copy the alpha channel as is instead of blending onto the
+		// transparent sheet
+		SDL_Rect cell = SDLRectMake((i % PieceTypeNone) * cell_width, (i / PieceTypeNone) * cell_height,
+			cell_width, cell_height);
+		SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+		SDL_BlitScaled(surfaces[i], nullptr, m_piece_sheet, &cell);
+	}
+	free_surfaces();
 }
 
-void ChessGame::draw_pieces()
+// Makes m_piece_atlas an atlas whose cells are exactly one tile, so every
+// piece is drawn 1:1 and the renderer never scales sprites. Scaling is
+// done once per size on the CPU with proper filtering and then cached.
+void ChessGame::select_piece_atlas()
 {
-	for (std::size_t y = 0; y < m_board.GetHeight(); y++) {
-		for (std::size_t x = 0; x < m_board.GetWidth(); x++) {
-			const ChessPieceLocation loc = ChessPieceLocation(x, y);
-			const ChessPiece &piece = m_board.GetPiece(loc);
-
-			const SDL_Rect draw_rect = SDLRectMake(x * tile_width, y * tile_height, tile_width, tile_height);
-			switch (piece.GetOwner()) {
-				case PlayerBlack: {
-					// add 6 because of how the pieces are laid out
-					std::size_t texture_offset = 6 + piece.GetType();
-					assert(texture_offset <= 11);
-
-					SDL_RenderCopy(m_main_renderer, m_piece_textures[texture_offset], NULL, &draw_rect);
-					break;
-				}
-				case PlayerWhite: {
-					std::size_t texture_offset = piece.GetType();
-					assert(texture_offset <= 5);
-
-					SDL_RenderCopy(m_main_renderer, m_piece_textures[texture_offset], NULL, &draw_rect);
-					break;
-				}
-				
-				case PlayerNone: {
-					// draw nothing
-					break;
-				}
-				default: {
-					throw std::runtime_error("Unknown player type!");
-					break;
-				}
-			}
+	for (auto it = m_scaled_atlases.begin(); it != m_scaled_atlases.end(); ++it) {
+		if (it->cell_width == m_tile_width && it->cell_height == m_tile_height) {
+			// Move it to the back so it is the last to be evicted
+			const ScaledPieceAtlas atlas = *it;
+			m_scaled_atlases.erase(it);
+			m_scaled_atlases.push_back(atlas);
+			m_piece_atlas = atlas.texture;
+			return;
 		}
 	}
+
+	SDL_Surface *scaled = ScaleSpriteSheet(m_piece_sheet, PieceTypeNone, PlayerNone, m_tile_width, m_tile_height);
+	if (!scaled)
+		throw std::runtime_error("Failed to scale the piece atlas!");
+
+	SDL_Texture *texture = SDL_CreateTextureFromSurface(m_main_renderer, scaled);
+	SDL_FreeSurface(scaled);
+	if (!texture)
+		throw std::runtime_error("Failed to load texture!");
+
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+	SDL_SetTextureScaleMode(texture, SDL_ScaleModeNearest);
+
+	if (m_scaled_atlases.size() >= max_scaled_atlases) {
+		SDL_DestroyTexture(m_scaled_atlases.front().texture);
+		m_scaled_atlases.erase(m_scaled_atlases.begin());
+	}
+	m_scaled_atlases.push_back({ m_tile_width, m_tile_height, texture });
+	m_piece_atlas = texture;
 }
 
-static int __white_y_offset_if_necessary(const ChessPiece &piece, int offset)
+SDL_Rect ChessGame::piece_atlas_rect(ChessPiece piece) const
 {
-	if (piece.GetOwner() == PlayerWhite)
-		return -offset;
-	
-	return offset;
+	return SDLRectMake(piece.GetType() * m_tile_width, piece.GetOwner() * m_tile_height,
+		m_tile_width, m_tile_height);
 }
 
-void ChessGame::add_valid_pawn_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc)
+// Sizes the tiles to the renderer's output, which is in real pixels on
+// high DPI displays, and brings everything sized by them up to date
+void ChessGame::update_layout()
 {
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x, loc.y + __white_y_offset_if_necessary(piece, 1))) {
-		const ChessPieceLocation tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-
-		if (!other_piece.IsValid() && !piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
+	int output_width, output_height;
+	if (SDL_GetRendererOutputSize(m_main_renderer, &output_width, &output_height) != 0) {
+		output_width = window_width;
+		output_height = window_height;
 	}
 
-	
-	if (piece.GetMoveCount() == 0) {
-		// no need for validation
-		if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x, loc.y + __white_y_offset_if_necessary(piece, 2))) {
-			const ChessPieceLocation tmp_loc = *opt;
-			const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-
-			if (!other_piece.IsValid() && !piece.IsFriendly(other_piece))
-				moves.push_back(tmp_loc);
-		}
-	}
+	m_tile_width = std::max(1, output_width / int(m_board.GetWidth()));
+	m_tile_height = std::max(1, output_height / int(m_board.GetHeight()));
 
-	// Kill Moves
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 1, loc.y + __white_y_offset_if_necessary(piece, 1))) {
-		const ChessPieceLocation tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+	invalidate_board_texture();
+	select_piece_atlas();
+}
 
-		if (other_piece.IsValid() && !piece.IsFriendly(other_piece))
-			moves.push_back(ChessPieceLocation(tmp_loc));
-	}
+const BoardTheme &ChessGame::theme() const
+{
+	return s_board_themes[m_theme_index];
+}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 1, loc.y + __white_y_offset_if_necessary(piece, 1))) {
-		const ChessPieceLocation tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		
-		if (other_piece.IsValid() && !piece.IsFriendly(other_piece))
-			moves.push_back(ChessPieceLocation(tmp_loc));
-	}
+void ChessGame::invalidate_board_texture()
+{
+	if (m_board_texture)
+		SDL_DestroyTexture(m_board_texture);
+	m_board_texture = nullptr;
+	m_dirty = true;
 }
 
-void ChessGame::add_valid_rook_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc)
+SDL_Rect ChessGame::tile_rect(Square square) const
 {
-	for (auto x = loc.x + 1; x < m_board.GetWidth(); x++) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(x, loc.y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		moves.push_back(tmp_loc);
-		if (other_piece.IsValid()) {
-			break;
-		}
-	}
+	return SDLRectMake(SquareX(square) * m_tile_width, SquareY(square) * m_tile_height, m_tile_width, m_tile_height);
+}
 
-	for (int x = loc.x - 1; x >= 0; x--) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(x, loc.y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		moves.push_back(tmp_loc);
-		if (other_piece.IsValid()) {
-			break;
+void ChessGame::render_board_tiles()
+{
+	for (std::size_t y = 0; y < m_board.GetHeight(); y++) {
+		for (std::size_t x = 0; x < m_board.GetWidth(); x++) {
+			// draw checkerboard pattern
+			const SDL_Color &color = ((x % 2 == 0) ^ (y % 2 == 0)) ? theme().dark : theme().light;
+			m_under_pieces.Add(color, tile_rect(MakeSquare(x, y)));
 		}
 	}
+	m_under_pieces.Submit(m_main_renderer);
+}
 
-	for (auto y = loc.y + 1; y < m_board.GetHeight(); y++) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(loc.x, y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		moves.push_back(tmp_loc);
-		if (other_piece.IsValid()) {
-			break;
+// The board only changes with the window size or the theme, so it is
+// drawn into a target texture once and copied in a single call per frame
+void ChessGame::draw_board()
+{
+	if (!m_board_texture && SDL_RenderTargetSupported(m_main_renderer)) {
+		m_board_texture = SDL_CreateTexture(m_main_renderer, SDL_PIXELFORMAT_RGBA8888,
+			SDL_TEXTUREACCESS_TARGET, m_tile_width * m_board.GetWidth(), m_tile_height * m_board.GetHeight());
+
+		if (m_board_texture && SDL_SetRenderTarget(m_main_renderer, m_board_texture) == 0) {
+			render_board_tiles();
+			SDL_SetRenderTarget(m_main_renderer, nullptr);
+		} else {
+			invalidate_board_texture();
 		}
 	}
 
-	for (int y = loc.y - 1; y >= 0; y--) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(loc.x, y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		moves.push_back(tmp_loc);
-		if (other_piece.IsValid()) {
-			break;
-		}
+	// Drivers without render targets still get a board, just drawn every frame
+	if (!m_board_texture) {
+		render_board_tiles();
+		return;
 	}
+
+	const SDL_Rect board_rect = SDLRectMake(0, 0, m_tile_width * m_board.GetWidth(), m_tile_height * m_board.GetHeight());
+	SDL_RenderCopy(m_main_renderer, m_board_texture, nullptr, &board_rect);
 }
 
-void ChessGame::add_valid_knight_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc)
+// All sprites come from the one atlas texture, so the copies below are
+// queued back to back with no texture switches between them. SDL 2.0.12
+// still issues one draw per copy when its queue is flushed.
+void ChessGame::draw_pieces()
 {
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 1, loc.y + 2)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	for (std::size_t player = PlayerWhite; player < PlayerNone; player++) {
+		for (std::size_t type = PieceTypePawn; type < PieceTypeNone; type++) {
+			const SDL_Rect source_rect = piece_atlas_rect(ChessPiece(Player(player), PieceType(type)));
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 1, loc.y - 2)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+			Bitboard pieces = m_board.GetPieces(Player(player), PieceType(type));
+			while (pieces) {
+				const SDL_Rect draw_rect = tile_rect(PopLowestSquare(pieces));
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
+				SDL_RenderCopy(m_main_renderer, m_piece_atlas, &source_rect, &draw_rect);
+			}
+		}
 	}
+}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 1, loc.y + 2)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+// Plays a move on the game board, keeping it in the game's history
+void ChessGame::play_move(Move move)
+{
+	m_history.emplace_back();
+	m_board.MakeMove(move, m_history.back());
+}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 1, loc.y - 2)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+// Moves the piece on square can make
+void ChessGame::get_valid_moves(MoveList &moves, Square square)
+{
+	MoveList all_moves;
+	GenerateMoves(m_board, all_moves);
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
+	for (const Move &move : all_moves) {
+		if (move.From() == square)
+			moves.Add(move);
 	}
+}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 2, loc.y + 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+// Reports check, checkmate and stalemate in the window title
+void ChessGame::update_window_title()
+{
+	const Player side = m_board.GetSideToMove();
+	const bool in_check = m_board.InCheck(side);
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	MoveList moves;
+	GenerateMoves(m_board, moves);
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 2, loc.y - 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+	const char *title = "Chess(tm)";
+	if (moves.Empty() && in_check)
+		title = (side == PlayerWhite) ? "Chess(tm) - Checkmate, Black wins" : "Chess(tm) - Checkmate, White wins";
+	else if (moves.Empty())
+		title = "Chess(tm) - Stalemate";
+	else if (in_check)
+		title = "Chess(tm) - Check";
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	SDL_SetWindowTitle(m_main_window, title);
+}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 2, loc.y + 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+// Asks the engine for a move if it is the engine's turn. The answer
+// arrives later through poll_engine.
+void ChessGame::start_engine_move()
+{
+	if (!m_engine || m_board.GetSideToMove() != m_engine_player || m_engine_search_id)
+		return;
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	MoveList moves;
+	GenerateMoves(m_board, moves);
+	if (moves.Empty())
+		return;
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 2, loc.y - 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+	// The hash saved before each move is the position it was played from
+	std::vector<HashKey> history;
+	history.reserve(m_history.size());
+	for (const UndoEntry &undo : m_history)
+		history.push_back(undo.hash);
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	SearchLimits limits;
+	limits.movetime_ms = engine_movetime_ms;
+	m_engine_search_id = m_engine->StartSearch(m_board, history.data(), history.size(), limits);
 }
 
-void ChessGame::add_valid_bishop_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc)
+void ChessGame::handle_engine_result(const EngineResult &result)
 {
+	// Answers for a search that was abandoned or a board that has
+	// changed since are of no use
+	if (result.id != m_engine_search_id || result.hash != m_board.GetHash())
+		return;
 
-	for (auto x = loc.x + 1, y = loc.y + 1; x < m_board.GetWidth() && y < m_board.GetHeight(); x++, y++) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(x, y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		if (other_piece.IsValid()) {
-			moves.push_back(tmp_loc);
-			break;
-		}
-		moves.push_back(tmp_loc);
-	}
+	if (result.type == EngineResultInfo) {
+		char score[24];
+		FormatScore(result.info.score, score, sizeof(score));
 
-	for (auto x = loc.x + 1, y = loc.y - 1; x < m_board.GetWidth() && y < m_board.GetHeight(); x++, y--) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(x, y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		if (other_piece.IsValid()) {
-			moves.push_back(tmp_loc);
-			break;
-		}
-		moves.push_back(tmp_loc);
+		char title[96];
+		std::snprintf(title, sizeof(title), "Chess(tm) - Thinking, depth %u, %s", result.info.depth, score);
+		SDL_SetWindowTitle(m_main_window, title);
+		return;
 	}
 
-	for (auto x = loc.x - 1, y = loc.y + 1; x < m_board.GetWidth() && y < m_board.GetHeight(); x--, y++) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(x, y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		if (other_piece.IsValid()) {
-			moves.push_back(tmp_loc);
-			break;
-		}
-		moves.push_back(tmp_loc);
-	}
+	m_engine_search_id = 0;
+	m_dirty = true;
 
-	for (auto x = loc.x - 1, y = loc.y - 1; x < m_board.GetWidth() && y < m_board.GetHeight(); x--, y--) {
-		const ChessPieceLocation tmp_loc = ChessPieceLocation(x, y);
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-		if (piece.IsFriendly(other_piece))
-			break;
-		if (other_piece.IsValid()) {
-			moves.push_back(tmp_loc);
+	// Only play the move if it really is legal here
+	MoveList moves;
+	GenerateMoves(m_board, moves);
+	for (const Move &move : moves) {
+		if (move == result.info.BestMove()) {
+			play_move(move);
+			m_show_possible_moves = false;
 			break;
 		}
-		moves.push_back(tmp_loc);
 	}
+	update_window_title();
 }
 
-void ChessGame::add_valid_queen_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc)
+// Takes whatever the engine has sent since the last frame without waiting
+void ChessGame::poll_engine()
 {
-	add_valid_bishop_moves(moves, piece, loc);
-	add_valid_rook_moves(moves, piece, loc);
-	add_valid_king_moves(moves, piece, loc);
+	if (!m_engine)
+		return;
+
+	EngineResult result;
+	while (m_engine->PollResult(result))
+		handle_engine_result(result);
 }
 
-void ChessGame::add_valid_king_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc)
+void ChessGame::play_player_move(Move move)
 {
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x, loc.y + 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
-
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x, loc.y - 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
-
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	play_move(move);
+	update_window_title();
+	start_engine_move();
+}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 1, loc.y)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+// Promotion choices are shown in a column starting on the promotion
+// square and running towards the middle of the board
+Square ChessGame::promotion_choice_square(std::size_t index) const
+{
+	const Square to = m_promotion_choices[0].To();
+	return (SquareY(to) == 0) ? Square(to + index * 8) : Square(to - index * 8);
+}
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+void ChessGame::handle_click(const SDL_MouseButtonEvent &event)
+{
+	if (event.button != SDL_BUTTON_LEFT)
+		return;
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 1, loc.y)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+	// The board is the engine's while it thinks
+	if (m_engine && m_board.GetSideToMove() == m_engine_player)
+		return;
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
+	// Mouse positions are in window coordinates, which on high DPI
+	// displays are smaller than the renderer's pixels
+	int window_w, window_h, output_w, output_h;
+	SDL_GetWindowSize(m_main_window, &window_w, &window_h);
+	if (SDL_GetRendererOutputSize(m_main_renderer, &output_w, &output_h) != 0 || window_w <= 0 || window_h <= 0) {
+		output_w = window_w = 1;
+		output_h = window_h = 1;
 	}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 1, loc.y + 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+	const int x = event.x * output_w / window_w;
+	const int y = event.y * output_h / window_h;
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	const std::size_t tile_x = x / m_tile_width;
+	const std::size_t tile_y = y / m_tile_height;
+	if (tile_x >= m_board.GetWidth() || tile_y >= m_board.GetHeight())
+		return;
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x + 1, loc.y - 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+	const ChessPieceLocation click_loc = ChessPieceLocation(tile_x, tile_y);
+	m_dirty = true;
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+	if (!m_promotion_choices.Empty()) {
+		// Clicking anywhere but on a choice takes the pawn move back
+		for (std::size_t i = 0; i < m_promotion_choices.Size(); i++) {
+			if (promotion_choice_square(i) == click_loc.ToSquare()) {
+				play_player_move(m_promotion_choices[i]);
+				break;
+			}
+		}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 1, loc.y + 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+		m_promotion_choices.Clear();
+	} else if (m_show_possible_moves) {
+		for (const Move &move : m_possible_moves) {
+			if (move.To() != click_loc.ToSquare())
+				continue;
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
-	}
+			if (!move.IsPromotion()) {
+				play_player_move(move);
+				break;
+			}
 
-	if (auto opt = ChessPieceLocation::CreateLocationIfPossible(loc.x - 1, loc.y - 1)) {
-		const ChessPieceLocation &tmp_loc = *opt;
-		const ChessPiece &other_piece = m_board.GetPiece(tmp_loc);
+			// Every promotion shares the same squares, so the player
+			// picks the piece before anything is played
+			constexpr PieceType order[] = { PieceTypeQueen, PieceTypeKnight, PieceTypeRook, PieceTypeBishop };
+			for (const PieceType type : order) {
+				for (const Move &promotion : m_possible_moves) {
+					if (promotion.To() == move.To() && promotion.PromotionType() == type)
+						m_promotion_choices.Add(promotion);
+				}
+			}
+			break;
+		}
 
-		if (!piece.IsFriendly(other_piece))
-			moves.push_back(tmp_loc);
+		m_show_possible_moves = false;
+	} else {
+		const ChessPiece piece = m_board.GetPiece(click_loc.ToSquare());
+		if (!piece.IsValid() || piece.GetOwner() != m_board.GetSideToMove())
+			return;
+	
+		m_possible_moves.Clear();
+		get_valid_moves(m_possible_moves, click_loc.ToSquare());
+		if (m_possible_moves.Empty())
+			return;
+		
+		m_show_possible_moves = true;
 	}
 }
 
-std::vector<ChessPieceLocation> ChessGame::get_valid_moves(const ChessPiece &piece, const ChessPieceLocation &loc)
+void ChessGame::handle_event(const SDL_Event &e)
 {
-	std::vector<ChessPieceLocation> moves;
-	switch (piece.GetType()) {
-		case PieceTypePawn: {
-			add_valid_pawn_moves(moves, piece, loc);
+	switch (e.type) {
+		case SDL_QUIT: {
+			m_running = false;
 			break;
 		}
-		case PieceTypeRook: {
-			add_valid_rook_moves(moves, piece, loc);
+		case SDL_MOUSEBUTTONUP: {
+			handle_click(e.button);
 			break;
 		}
-		case PieceTypeKnight: {
-			add_valid_knight_moves(moves, piece, loc);
-			break;
-		}
-		case PieceTypeBishop: {
-			add_valid_bishop_moves(moves, piece, loc);
+		case SDL_KEYDOWN: {
+			if (e.key.keysym.sym == SDLK_t) {
+				m_theme_index = (m_theme_index + 1) % (sizeof(s_board_themes) / sizeof(s_board_themes[0]));
+				invalidate_board_texture();
+			}
 			break;
 		}
-		case PieceTypeQueen: {
-			add_valid_queen_moves(moves, piece, loc);
+		case SDL_WINDOWEVENT: {
+			// The window system may have thrown away what was drawn
+			if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+				update_layout();
+			else if (e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_RESTORED)
+				m_dirty = true;
 			break;
 		}
-		case PieceTypeKing: {
-			add_valid_king_moves(moves, piece, loc);
+		case SDL_RENDER_TARGETS_RESET: {
+			// Some drivers lose the contents of target textures
+			invalidate_board_texture();
 			break;
 		}
-		default: {
-			throw std::runtime_error("Unknown piece type!");
+		case SDL_RENDER_DEVICE_RESET: {
+			// Every texture is gone, rebuild the ones sized to the window
+			unload_scaled_atlases();
+			update_layout();
 			break;
 		}
 	}
-
-	return moves;
+	// Engine events carry nothing, poll_engine picks up the results
 }
 
-void ChessGame::handle_click(const SDL_MouseButtonEvent &event)
+// Waits up to timeout_ms for an event, forever if it is negative, then
+// handles everything that is queued
+void ChessGame::poll_events(int timeout_ms)
 {
-	if (event.button != SDL_BUTTON_LEFT)
+	SDL_Event e;
+	const int got_event = (timeout_ms < 0) ? SDL_WaitEvent(&e) : SDL_WaitEventTimeout(&e, timeout_ms);
+	if (!got_event)
 		return;
 
-	const int x = event.x;
-	const int y = event.y;
-
-	const std::size_t tile_x = x / tile_width;
-	const std::size_t tile_y = y / tile_height;
+	handle_event(e);
+	while (SDL_PollEvent(&e))
+		handle_event(e);
+}
 
-	const ChessPieceLocation click_loc = ChessPieceLocation(tile_x, tile_y);
+void ChessGame::update(float dt)
+{
+	poll_engine();
+}
 
-	if (m_show_possible_moves) {
-		if (!m_possible_moves.empty()) {
-			for (const auto &move : m_possible_moves) {
-				if (move == click_loc) {
-					const auto selected_piece_location = ChessPieceLocation(selected_piece_x, selected_piece_y);
-					m_board.MovePiece(selected_piece_location, move);
-					if (m_turn == PlayerWhite)
-						m_turn = PlayerBlack;
-					else
-						m_turn = PlayerWhite;
-				}
-			}
-		}
+void ChessGame::draw_last_move()
+{
+	if (m_history.empty())
+		return;
 
-		m_show_possible_moves = false;
-	} else {
-		const ChessPiece &piece = m_board.GetPiece(click_loc);
-		if (!piece.IsValid() || piece.GetOwner() != m_turn)
-			return;
-	
-		const std::vector<ChessPieceLocation> moves = get_valid_moves(piece, click_loc);
-		if (moves.empty())
-			return;
-		
-		m_possible_moves = moves;
-		m_show_possible_moves = true;
-		selected_piece_x = click_loc.x;
-		selected_piece_y = click_loc.y;
-	}
+	const Move last_move = m_history.back().move;
+	m_under_pieces.Add(theme().last_move, tile_rect(last_move.From()));
+	m_under_pieces.Add(theme().last_move, tile_rect(last_move.To()));
 }
 
-void ChessGame::poll_events()
+void ChessGame::draw_check()
 {
-	SDL_Event e;
-	while (SDL_PollEvent(&e)) {
-		switch (e.type) {
-			case SDL_QUIT: {
-				m_running = false;
-				break;
-			}
-			case SDL_MOUSEBUTTONUP: {
-				handle_click(e.button);
-				break;
-			}
-		}
-	}
+	const Player side = m_board.GetSideToMove();
+	if (m_board.InCheck(side))
+		m_under_pieces.Add(theme().check, tile_rect(LowestSquare(m_board.GetPieces(side, PieceTypeKing))));
 }
 
-void ChessGame::update(float dt)
+void ChessGame::draw_possible_moves()
 {
-	poll_events();
+	for (const Move &move : m_possible_moves)
+		m_over_pieces.Add(theme().move_highlight, tile_rect(move.To()));
 }
 
-void ChessGame::draw_possible_moves()
+// Draws the pieces a pawn can promote to on top of everything else
+void ChessGame::draw_promotion_choices()
 {
-	for (auto &loc : m_possible_moves) {
-		const SDL_Rect fillRect = {
-			(int)loc.x * tile_width,
-			(int)loc.y * tile_height,
-			tile_width,
-			tile_height
-		};
+	for (std::size_t i = 0; i < m_promotion_choices.Size(); i++)
+		m_over_pieces.Add(theme().move_highlight, tile_rect(promotion_choice_square(i)));
+	m_over_pieces.Submit(m_main_renderer);
 
-		SDL_SetRenderDrawColor(m_main_renderer, 109, 219, 252, 255);
-		SDL_RenderFillRect(m_main_renderer, &fillRect);
+	const Player side = m_board.GetSideToMove();
+	for (std::size_t i = 0; i < m_promotion_choices.Size(); i++) {
+		const SDL_Rect source_rect = piece_atlas_rect(ChessPiece(side, m_promotion_choices[i].PromotionType()));
+		const SDL_Rect draw_rect = tile_rect(promotion_choice_square(i));
+		SDL_RenderCopy(m_main_renderer, m_piece_atlas, &source_rect, &draw_rect);
 	}
 }
 
@@ -550,22 +614,38 @@ void ChessGame::draw()
 	SDL_RenderClear(m_main_renderer);
 
 	draw_board();
+
+	draw_last_move();
+	draw_check();
+	m_under_pieces.Submit(m_main_renderer);
+
 	draw_pieces();
 
 	// draw possible moves
 	if (m_show_possible_moves) {
 		draw_possible_moves();
 	}
+	m_over_pieces.Submit(m_main_renderer);
+
+	if (!m_promotion_choices.Empty())
+		draw_promotion_choices();
 
 	SDL_RenderPresent(m_main_renderer);
 }
 
-void ChessGame::unload_piece_textures()
+void ChessGame::unload_scaled_atlases()
 {
-	for (SDL_Texture *&texture : m_piece_textures) {
-		SDL_DestroyTexture(texture);
-		texture = nullptr;
-	}
+	for (const ScaledPieceAtlas &atlas : m_scaled_atlases)
+		SDL_DestroyTexture(atlas.texture);
+	m_scaled_atlases.clear();
+	m_piece_atlas = nullptr;
+}
+
+void ChessGame::unload_piece_atlas()
+{
+	unload_scaled_atlases();
+	SDL_FreeSurface(m_piece_sheet);
+	m_piece_sheet = nullptr;
 }
 
 void ChessGame::cleanup_libraries()
@@ -576,7 +656,12 @@ void ChessGame::cleanup_libraries()
 
 void ChessGame::cleanup()
 {
-	unload_piece_textures();
+	// Stops any search and joins the engine thread
+	m_engine.reset();
+
+	invalidate_board_texture();
+
+	unload_piece_atlas();
 	SDL_DestroyRenderer(m_main_renderer);
 	SDL_DestroyWindow(m_main_window);
 
@@ -589,11 +674,32 @@ void ChessGame::run()
 
 	m_running = true;
 
-	float dt = 0.0;
+	typedef std::chrono::steady_clock clock;
+	const auto frame_interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(1.f / target_fps));
+
+	auto last_frame = clock::now() - frame_interval;
+	auto last_update = clock::now();
+
 	while (m_running) {
+		// With nothing to redraw, sleep until an event arrives. Otherwise
+		// wait out whatever is left of the frame, still handling input.
+		int timeout_ms = -1;
+		if (m_dirty) {
+			const auto remaining = frame_interval - (clock::now() - last_frame);
+			timeout_ms = std::max(0, int(std::chrono::ceil<std::chrono::milliseconds>(remaining).count()));
+		}
+		poll_events(timeout_ms);
+
+		const auto now = clock::now();
+		const float dt = std::chrono::duration<float>(now - last_update).count();
+		last_update = now;
 		update(dt);
-		draw();
-		SDL_Delay(1000.f / target_fps);
+
+		if (m_dirty && now - last_frame >= frame_interval) {
+			draw();
+			m_dirty = false;
+			last_frame = now;
+		}
 	}
 	cleanup();
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #define CHESSGAME_INCLUDE_H
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
@@ -13,7 +15,28 @@
 #include <chrono>
 #include <iostream>
 #include <ctime>
+#include <thread>
+#include <memory>
 #include "ChessBoard.h"
+#include "Engine.h"
+#include "MoveList.h"
+#include "RectBatch.h"
+
+// Colours the board is drawn in
+struct BoardTheme {
+	SDL_Color light;
+	SDL_Color dark;
+	SDL_Color move_highlight;
+	SDL_Color last_move;
+	SDL_Color check;
+};
+
+// The piece atlas resampled for one tile size
+struct ScaledPieceAtlas {
+	int cell_width;
+	int cell_height;
+	SDL_Texture *texture;
+};
 
 class ChessGame {
 private:
@@ -22,53 +45,101 @@ private:
 	constexpr static int window_width = 640;
 	constexpr static int window_height = 640;
 
-	constexpr static int tile_width = window_width / 8;
-	constexpr static int tile_height = window_height / 8;
+	// Scaled piece atlases kept around for recently used tile sizes
+	constexpr static std::size_t max_scaled_atlases = 4;
+
+	constexpr static std::size_t engine_hash_megabytes = 64;
+	constexpr static std::uint64_t engine_movetime_ms = 1000;
 
 	bool m_running = false;
 	bool m_show_possible_moves = false;
+	// Set whenever what's on screen is out of date. Nothing is drawn
+	// while it is clear.
+	bool m_dirty = true;
+	// Event the engine thread pushes to wake the loop when it has a result
+	std::uint32_t m_engine_event = 0;
 
 	SDL_Window *m_main_window = nullptr;
 	SDL_Renderer *m_main_renderer = nullptr;
 
+	// The empty checkerboard, drawn once and copied every frame. Null
+	// when it needs drawing again.
+	SDL_Texture *m_board_texture = nullptr;
+	std::size_t m_theme_index = 0;
+
 	ChessBoard m_board;
-	std::array<SDL_Texture *, 12> m_piece_textures;
+	// Size of a tile in renderer pixels, following the window size
+	int m_tile_width = window_width / 8;
+	int m_tile_height = window_height / 8;
+
+	// Every piece sprite at full resolution, white pieces on the top row
+	// and black on the bottom, one column per PieceType
+	SDL_Surface *m_piece_sheet = nullptr;
+	// Atlases already scaled to a tile size, most recently used last.
+	// m_piece_atlas is the one matching the current tile size.
+	std::vector<ScaledPieceAtlas> m_scaled_atlases;
+	SDL_Texture *m_piece_atlas = nullptr;
 	std::vector<std::string> m_args;
 	
-	int selected_piece_x = -1;
-	int selected_piece_y = -1;
-	
-	std::vector<ChessPieceLocation> m_possible_moves;
+	MoveList m_possible_moves;
+	// Promotions the player is picking between, queen first. Empty
+	// unless a pawn has been moved onto its last row.
+	MoveList m_promotion_choices;
+	// Every move played so far, oldest first. It grows with the game, so
+	// games of any length fit.
+	std::vector<UndoEntry> m_history;
+
+	// Overlays drawn under the pieces and over them. Anything filled with
+	// flat colour goes through these, never through SDL_RenderFillRect.
+	RectBatch m_under_pieces;
+	RectBatch m_over_pieces;
 
-	Player m_turn = PlayerWhite;
+	// Computer opponent, playing m_engine_player (PlayerNone for none)
+	std::unique_ptr<Engine> m_engine;
+	Player m_engine_player = PlayerBlack;
+	// Id of the search whose answer is awaited, zero when none is
+	std::uint32_t m_engine_search_id = 0;
 
 	// Setup Functions
 	void setup_libraries();
 	void setup();
-	void load_piece_textures(std::array<SDL_Texture *, 12> &texts);
+	void load_piece_atlas();
+	void select_piece_atlas();
+	void update_layout();
 
 	// Logic Functions
-	void poll_events();
+	void poll_events(int timeout_ms);
+	void handle_event(const SDL_Event &e);
 	void update(float dt);
 	void handle_click(const SDL_MouseButtonEvent &event);
+	void play_player_move(Move move);
+	Square promotion_choice_square(std::size_t index) const;
 
-	std::vector<ChessPieceLocation> get_valid_moves(const ChessPiece &piece, const ChessPieceLocation &loc);
+	void play_move(Move move);
+	void get_valid_moves(MoveList &moves, Square square);
+	void update_window_title();
+
+	void start_engine_move();
+	void poll_engine();
+	void handle_engine_result(const EngineResult &result);
 
-	void add_valid_pawn_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc);
-	void add_valid_rook_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc);
-	void add_valid_knight_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc);
-	void add_valid_bishop_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc);
-	void add_valid_queen_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc);
-	void add_valid_king_moves(std::vector<ChessPieceLocation> &moves, const ChessPiece &piece, const ChessPieceLocation &loc);
-	
 	// Drawing functions
+	const BoardTheme &theme() const;
+	void invalidate_board_texture();
+	void render_board_tiles();
+	SDL_Rect piece_atlas_rect(ChessPiece piece) const;
+	SDL_Rect tile_rect(Square square) const;
+	void draw_last_move();
+	void draw_check();
 	void draw_possible_moves();
+	void draw_promotion_choices();
 	void draw_board();
 	void draw_pieces();
 	void draw();
 
 	// Cleanup Functions
-	void unload_piece_textures();
+	void unload_scaled_atlases();
+	void unload_piece_atlas();
 	void cleanup_libraries();
 	void cleanup();
 public:
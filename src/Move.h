@@ -0,0 +1,90 @@
+#ifndef MOVE_INCLUDE_H
+#define MOVE_INCLUDE_H
+#include "Bitboard.h"
+#include "ChessPiece.h"
+#include <cstddef>
+#include <cstdint>
+
+// Upper four bits of a Move. Bit 2 marks captures and bit 3 marks
+// promotions, with the low two bits picking the promoted piece.
+enum MoveFlag : std::uint16_t {
+	MoveFlagQuiet = 0,
+	MoveFlagDoublePush = 1,
+	MoveFlagKingCastle = 2,
+	MoveFlagQueenCastle = 3,
+	MoveFlagCapture = 4,
+	MoveFlagEnPassant = 5,
+	MoveFlagPromoteKnight = 8,
+	MoveFlagPromoteBishop = 9,
+	MoveFlagPromoteRook = 10,
+	MoveFlagPromoteQueen = 11,
+	MoveFlagPromoteKnightCapture = 12,
+	MoveFlagPromoteBishopCapture = 13,
+	MoveFlagPromoteRookCapture = 14,
+	MoveFlagPromoteQueenCapture = 15
+};
+
+// A move packed into 16 bits: from square in bits 0-5, to square in
+// bits 6-11 and a MoveFlag in bits 12-15
+class Move {
+private:
+	std::uint16_t m_data;
+
+	constexpr explicit Move(std::uint16_t data) : m_data(data) {}
+public:
+	Move() = default;
+	constexpr Move(Square from, Square to, MoveFlag flags = MoveFlagQuiet)
+		: m_data(static_cast<std::uint16_t>(from | (to << 6) | (flags << 12)))
+	{
+	}
+
+	// Never generated for a real position, since from and to are the same square
+	static constexpr Move None() { return Move(std::uint16_t(0)); }
+	// Rebuilds a move stored with Raw
+	static constexpr Move FromRaw(std::uint16_t data) { return Move(data); }
+
+	constexpr Square From() const { return Square(m_data & 0x3F); }
+	constexpr Square To() const { return Square((m_data >> 6) & 0x3F); }
+	constexpr MoveFlag Flags() const { return MoveFlag(m_data >> 12); }
+	constexpr std::uint16_t Raw() const { return m_data; }
+
+	constexpr bool IsNone() const { return m_data == 0; }
+	constexpr bool IsCapture() const { return (Flags() & MoveFlagCapture) != 0; }
+	constexpr bool IsPromotion() const { return (Flags() & MoveFlagPromoteKnight) != 0; }
+	constexpr bool IsEnPassant() const { return Flags() == MoveFlagEnPassant; }
+	constexpr bool IsDoublePush() const { return Flags() == MoveFlagDoublePush; }
+	constexpr bool IsCastle() const {
+		return (Flags() == MoveFlagKingCastle) || (Flags() == MoveFlagQueenCastle);
+	}
+
+	constexpr PieceType PromotionType() const {
+		constexpr PieceType types[4] = { PieceTypeKnight, PieceTypeBishop, PieceTypeRook, PieceTypeQueen };
+		return types[Flags() & 3];
+	}
+
+	constexpr bool operator==(const Move &other) const {
+		return m_data == other.m_data;
+	}
+	constexpr bool operator!=(const Move &other) const {
+		return m_data != other.m_data;
+	}
+};
+
+static_assert(sizeof(Move) == 2, "Move must stay 16 bits");
+
+// Writes the move in coordinate notation (e2e4, e7e8q) followed by a
+// terminating null. out needs room for 6 characters.
+inline void FormatMove(Move move, char *out)
+{
+	const Square squares[2] = { move.From(), move.To() };
+	for (Square square : squares) {
+		*out++ = static_cast<char>('a' + SquareX(square));
+		*out++ = static_cast<char>('8' - SquareY(square));
+	}
+
+	if (move.IsPromotion())
+		*out++ = "prnbqk"[move.PromotionType()];
+	*out = '\0';
+}
+
+#endif // MOVE_INCLUDE_H
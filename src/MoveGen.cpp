@@ -0,0 +1,241 @@
+#include "MoveGen.h"
+#include "Attacks.h"
+
+// Adds one move from the given square to every square set in targets
+static void add_moves_from_bitboard(MoveList &moves, Square from, Bitboard targets, MoveFlag flags)
+{
+	while (targets)
+		moves.Add(Move(from, PopLowestSquare(targets), flags));
+}
+
+// Adds one move to every square set in targets, coming from offset
+// squares before it. Moves onto the last row become one per promotion.
+static void add_pawn_moves(MoveList &moves, Bitboard targets, int offset, MoveFlag flags)
+{
+	Bitboard promotions = targets & (BitboardRow0 | BitboardRow7);
+	targets ^= promotions;
+
+	while (targets) {
+		const Square to = PopLowestSquare(targets);
+		moves.Add(Move(Square(to - offset), to, flags));
+	}
+
+	const MoveFlag promotion_flags[] = {
+		MoveFlagPromoteQueen, MoveFlagPromoteKnight, MoveFlagPromoteRook, MoveFlagPromoteBishop
+	};
+	while (promotions) {
+		const Square to = PopLowestSquare(promotions);
+		for (MoveFlag promotion : promotion_flags)
+			moves.Add(Move(Square(to - offset), to, MoveFlag(promotion | flags)));
+	}
+}
+
+// Adds the moves of a set of pawns that may only land on squares in allowed
+static void add_pawn_moves(const ChessBoard &board, MoveList &moves, Player us, Bitboard pawns, Bitboard allowed)
+{
+	const int dy = PawnDirection(us);
+	const Bitboard empty = ~board.GetOccupancy();
+	const Bitboard enemies = board.GetPlayerPieces(OpponentOf(us));
+
+	const Bitboard single_push = ShiftBitboard(pawns, 0, dy) & empty;
+	add_pawn_moves(moves, single_push & allowed, dy * 8, MoveFlagQuiet);
+
+	// Pawns that just left their starting row with a single push can go one more
+	const Bitboard skipped_row = RowBit((us == PlayerWhite) ? 5 : 2);
+	const Bitboard double_push = ShiftBitboard(single_push & skipped_row, 0, dy) & empty;
+	add_pawn_moves(moves, double_push & allowed, dy * 16, MoveFlagDoublePush);
+
+	// Kill Moves
+	const Bitboard targets = enemies & allowed;
+	add_pawn_moves(moves, ShiftBitboard(pawns, 1, dy) & targets, dy * 8 + 1, MoveFlagCapture);
+	add_pawn_moves(moves, ShiftBitboard(pawns, -1, dy) & targets, dy * 8 - 1, MoveFlagCapture);
+}
+
+template <SlidingIndex Index>
+static Bitboard piece_attacks(PieceType type, Square square, Bitboard occupancy)
+{
+	switch (type) {
+		case PieceTypeRook:
+			return RookAttacks<Index>(square, occupancy);
+		case PieceTypeKnight:
+			return KnightAttacks(square);
+		case PieceTypeBishop:
+			return BishopAttacks<Index>(square, occupancy);
+		case PieceTypeQueen:
+			return QueenAttacks<Index>(square, occupancy);
+		case PieceTypeKing:
+			return KingAttacks(square);
+		default:
+			assert(false && "Pawns are generated set-wise");
+			return 0;
+	}
+}
+
+// Adds a move to every attacked square in allowed that isn't held by a
+// friendly piece, flagging the ones that land on an enemy piece as
+// captures. Pinned pieces are further held to the line through the king.
+template <SlidingIndex Index>
+static void add_piece_moves(const ChessBoard &board, MoveList &moves, Player us, PieceType type, Bitboard allowed, Bitboard pinned, Square king)
+{
+	const Bitboard occupancy = board.GetOccupancy();
+	const Bitboard enemies = board.GetPlayerPieces(OpponentOf(us));
+
+	Bitboard pieces = board.GetPieces(us, type);
+	while (pieces) {
+		const Square from = PopLowestSquare(pieces);
+		Bitboard attacks = piece_attacks<Index>(type, from, occupancy) & allowed;
+		if (pinned & SquareBit(from))
+			attacks &= Line(king, from);
+
+		add_moves_from_bitboard(moves, from, attacks & ~occupancy, MoveFlagQuiet);
+		add_moves_from_bitboard(moves, from, attacks & enemies, MoveFlagCapture);
+	}
+}
+
+// Every square player attacks, given the occupancy
+template <SlidingIndex Index>
+static Bitboard attacked_squares(const ChessBoard &board, Player player, Bitboard occupancy)
+{
+	Bitboard attacked = PawnAttacksFromSet(player, board.GetPieces(player, PieceTypePawn));
+
+	const PieceType types[] = { PieceTypeKnight, PieceTypeBishop, PieceTypeRook, PieceTypeQueen, PieceTypeKing };
+	for (PieceType type : types) {
+		Bitboard pieces = board.GetPieces(player, type);
+		while (pieces)
+			attacked |= piece_attacks<Index>(type, PopLowestSquare(pieces), occupancy);
+	}
+
+	return attacked;
+}
+
+// Our pieces that are the only thing between our king and an enemy slider
+template <SlidingIndex Index>
+static Bitboard pinned_pieces(const ChessBoard &board, Player us, Square king)
+{
+	const Player them = OpponentOf(us);
+	const Bitboard occupancy = board.GetOccupancy();
+	const Bitboard queens = board.GetPieces(them, PieceTypeQueen);
+
+	Bitboard snipers = (RookAttacks<Index>(king, 0) & (board.GetPieces(them, PieceTypeRook) | queens))
+		| (BishopAttacks<Index>(king, 0) & (board.GetPieces(them, PieceTypeBishop) | queens));
+
+	Bitboard pinned = 0;
+	while (snipers) {
+		const Bitboard blockers = Between(king, PopLowestSquare(snipers)) & occupancy;
+		if (blockers && !HasManySquares(blockers))
+			pinned |= blockers & board.GetPlayerPieces(us);
+	}
+
+	return pinned;
+}
+
+// Adds en passant captures. Taking removes two pawns from the capturing
+// row at once, which can uncover a check no pin mask knows about, so the
+// king is tested against the occupancy after the capture instead.
+template <SlidingIndex Index>
+static void add_en_passant_moves(const ChessBoard &board, MoveList &moves, Player us, Square king, Bitboard check_mask)
+{
+	const Square target = board.GetEnPassantSquare();
+	if (target == SquareNone)
+		return;
+
+	const Player them = OpponentOf(us);
+	const Square taken = Square(target - PawnDirection(us) * 8);
+
+	// Must either take the checking pawn or block the check
+	if (!(check_mask & (SquareBit(target) | SquareBit(taken))))
+		return;
+
+	const Bitboard queens = board.GetPieces(them, PieceTypeQueen);
+	const Bitboard rooks = board.GetPieces(them, PieceTypeRook) | queens;
+	const Bitboard bishops = board.GetPieces(them, PieceTypeBishop) | queens;
+
+	Bitboard pawns = PawnAttacks(them, target) & board.GetPieces(us, PieceTypePawn);
+	while (pawns) {
+		const Square from = PopLowestSquare(pawns);
+		const Bitboard occupancy = board.GetOccupancy() ^ SquareBit(from) ^ SquareBit(taken) ^ SquareBit(target);
+
+		if ((RookAttacks<Index>(king, occupancy) & rooks) || (BishopAttacks<Index>(king, occupancy) & bishops))
+			continue;
+
+		moves.Add(Move(from, target, MoveFlagEnPassant));
+	}
+}
+
+// Adds castling moves. The king may not be in check, pass through an
+// attacked square or land on one, and everything between it and the
+// rook must be empty.
+static void add_castling_moves(const ChessBoard &board, MoveList &moves, Player us, Square king, Bitboard danger)
+{
+	const std::uint8_t rights = board.GetCastlingRights()
+		& ((us == PlayerWhite) ? (CastlingWhiteKingside | CastlingWhiteQueenside) : (CastlingBlackKingside | CastlingBlackQueenside));
+	if (!rights)
+		return;
+
+	const Bitboard occupancy = board.GetOccupancy();
+
+	if (rights & (CastlingWhiteKingside | CastlingBlackKingside)) {
+		const Bitboard path = SquareBit(king + 1) | SquareBit(king + 2);
+		if (!(occupancy & path) && !(danger & path))
+			moves.Add(Move(king, Square(king + 2), MoveFlagKingCastle));
+	}
+
+	if (rights & (CastlingWhiteQueenside | CastlingBlackQueenside)) {
+		const Bitboard path = SquareBit(king - 1) | SquareBit(king - 2);
+		if (!(occupancy & (path | SquareBit(king - 3))) && !(danger & path))
+			moves.Add(Move(king, Square(king - 2), MoveFlagQueenCastle));
+	}
+}
+
+template <SlidingIndex Index>
+void GenerateMoves(const ChessBoard &board, MoveList &moves)
+{
+	const Player us = board.GetSideToMove();
+	const Player them = OpponentOf(us);
+	const Bitboard kings = board.GetPieces(us, PieceTypeKing);
+	assert(kings && "Side to move has no king");
+
+	const Square king = LowestSquare(kings);
+	const Bitboard occupancy = board.GetOccupancy();
+	const Bitboard ours = board.GetPlayerPieces(us);
+	const Bitboard checkers = board.GetAttackersTo<Index>(king, them, occupancy);
+
+	// The king can't step onto an attacked square. Sliders see through
+	// the king, so it can't step back along the line it is checked on.
+	const Bitboard danger = attacked_squares<Index>(board, them, occupancy ^ kings);
+	const Bitboard king_targets = KingAttacks(king) & ~ours & ~danger;
+	add_moves_from_bitboard(moves, king, king_targets & ~occupancy, MoveFlagQuiet);
+	add_moves_from_bitboard(moves, king, king_targets & occupancy, MoveFlagCapture);
+
+	if (!checkers)
+		add_castling_moves(board, moves, us, king, danger);
+
+	// Out of a double check only the king can move
+	if (HasManySquares(checkers))
+		return;
+
+	// In check, other pieces must capture the checker or block its line
+	const Bitboard check_mask = checkers ? (checkers | Between(king, LowestSquare(checkers))) : ~Bitboard(0);
+	const Bitboard pinned = pinned_pieces<Index>(board, us, king);
+
+	Bitboard pinned_pawns = board.GetPieces(us, PieceTypePawn) & pinned;
+	add_pawn_moves(board, moves, us, board.GetPieces(us, PieceTypePawn) & ~pinned, check_mask);
+	while (pinned_pawns) {
+		const Square from = PopLowestSquare(pinned_pawns);
+		add_pawn_moves(board, moves, us, SquareBit(from), check_mask & Line(king, from));
+	}
+	add_en_passant_moves<Index>(board, moves, us, king, check_mask);
+
+	add_piece_moves<Index>(board, moves, us, PieceTypeKnight, check_mask, pinned, king);
+	add_piece_moves<Index>(board, moves, us, PieceTypeBishop, check_mask, pinned, king);
+	add_piece_moves<Index>(board, moves, us, PieceTypeRook, check_mask, pinned, king);
+	add_piece_moves<Index>(board, moves, us, PieceTypeQueen, check_mask, pinned, king);
+}
+
+void GenerateMoves(const ChessBoard &board, MoveList &moves)
+{
+	WithSlidingIndex([&](auto index) { GenerateMoves<decltype(index)::value>(board, moves); });
+}
+
+template void GenerateMoves<SlidingIndexMagic>(const ChessBoard &board, MoveList &moves);
+template void GenerateMoves<SlidingIndexPext>(const ChessBoard &board, MoveList &moves);
@@ -0,0 +1,17 @@
+#ifndef MOVEGEN_INCLUDE_H
+#define MOVEGEN_INCLUDE_H
+#include "Attacks.h"
+#include "ChessBoard.h"
+#include "MoveList.h"
+
+// Adds every legal move the side to move can make. Checkers and pinned
+// pieces are worked out once up front, and each piece's targets are
+// masked by them, so no move has to be made to test its legality. Index
+// must be ActiveSlidingIndex().
+template <SlidingIndex Index>
+void GenerateMoves(const ChessBoard &board, MoveList &moves);
+
+// Picks the sliding index itself, for code off the hot paths
+void GenerateMoves(const ChessBoard &board, MoveList &moves);
+
+#endif // MOVEGEN_INCLUDE_H
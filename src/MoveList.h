@@ -0,0 +1,35 @@
+#ifndef MOVELIST_INCLUDE_H
+#define MOVELIST_INCLUDE_H
+#include "Move.h"
+#include <cassert>
+#include <cstddef>
+
+// Fixed capacity list of moves that lives entirely on the stack. No
+// position has more than 218 legal moves, so the capacity is never hit.
+class MoveList {
+public:
+	static constexpr std::size_t CAPACITY = 256;
+private:
+	Move m_moves[CAPACITY];
+	std::size_t m_size = 0;
+public:
+	void Add(Move move) {
+		assert(m_size < CAPACITY && "MoveList is full");
+		m_moves[m_size++] = move;
+	}
+
+	void Clear() { m_size = 0; }
+
+	std::size_t Size() const { return m_size; }
+	bool Empty() const { return m_size == 0; }
+
+	Move &operator[](std::size_t i) { return m_moves[i]; }
+	const Move &operator[](std::size_t i) const { return m_moves[i]; }
+
+	Move *begin() { return m_moves; }
+	Move *end() { return m_moves + m_size; }
+	const Move *begin() const { return m_moves; }
+	const Move *end() const { return m_moves + m_size; }
+};
+
+#endif // MOVELIST_INCLUDE_H
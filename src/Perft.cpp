@@ -0,0 +1,206 @@
+#include "Perft.h"
+#include "CommandLine.h"
+#include "MoveGen.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Subtrees with more plies left than this are split into one task per
+// move instead of being counted by a single thread
+static constexpr unsigned PERFT_SPLIT_DEPTH = 4;
+
+// Longest line of moves a task can be reached by from the root
+static constexpr std::size_t PERFT_MAX_TASK_PATH = 16;
+
+// A subtree to count, described by the moves leading to it from the root,
+// so a task is a few bytes rather than a board copy
+struct PerftTask {
+	Move path[PERFT_MAX_TASK_PATH];
+	std::uint8_t path_length;
+	std::uint8_t depth;
+	std::uint8_t root_index;
+};
+
+PerftTable::PerftTable(std::size_t megabytes)
+{
+	std::size_t count = 1;
+	while (count * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+		count *= 2;
+
+	m_entries.reset(new Entry[count]());
+	m_mask = count - 1;
+}
+
+bool PerftTable::Probe(HashKey hash, unsigned depth, std::uint64_t &nodes) const
+{
+	const Entry &entry = m_entries[hash & m_mask];
+	const std::uint64_t check = entry.check.load(std::memory_order_relaxed);
+	const std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+
+	if ((check ^ data) != hash || (data & 0xFF) != depth)
+		return false;
+
+	nodes = data >> 8;
+	return true;
+}
+
+void PerftTable::Store(HashKey hash, unsigned depth, std::uint64_t nodes)
+{
+	Entry &entry = m_entries[hash & m_mask];
+	const std::uint64_t data = (nodes << 8) | depth;
+
+	entry.check.store(hash ^ data, std::memory_order_relaxed);
+	entry.data.store(data, std::memory_order_relaxed);
+}
+
+template <SlidingIndex Index>
+static std::uint64_t perft(ChessBoard &board, unsigned depth, PerftTable *table)
+{
+	if (depth == 0)
+		return 1;
+
+	std::uint64_t nodes = 0;
+	if (table && depth > 1 && table->Probe(board.GetHash(), depth, nodes))
+		return nodes;
+
+	MoveList moves;
+	GenerateMoves<Index>(board, moves);
+
+	// Bulk counting: the last ply is counted straight from the move list
+	if (depth == 1)
+		return moves.Size();
+
+	for (const Move &move : moves) {
+		UndoEntry undo;
+		board.MakeMove(move, undo);
+		nodes += perft<Index>(board, depth - 1, table);
+		board.UnmakeMove(undo);
+	}
+
+	if (table)
+		table->Store(board.GetHash(), depth, nodes);
+
+	return nodes;
+}
+
+std::uint64_t Perft(ChessBoard &board, unsigned depth, PerftTable *table)
+{
+	return WithSlidingIndex([&](auto index) { return perft<decltype(index)::value>(board, depth, table); });
+}
+
+template <SlidingIndex Index>
+static void parallel_perft(const ChessBoard &board, unsigned depth, std::size_t thread_count, PerftResult &result, PerftTable *table)
+{
+	result.root_moves.Clear();
+	GenerateMoves<Index>(board, result.root_moves);
+
+	WorkStealingPool<PerftTask> pool(thread_count);
+
+	std::vector<std::atomic<std::uint64_t>> divide(result.root_moves.Size());
+
+	for (std::size_t i = 0; i < result.root_moves.Size(); i++) {
+		PerftTask task;
+		task.path[0] = result.root_moves[i];
+		task.path_length = 1;
+		task.depth = static_cast<std::uint8_t>(depth - 1);
+		task.root_index = static_cast<std::uint8_t>(i);
+		pool.Push(i % pool.GetThreadCount(), task);
+	}
+
+	pool.Run([&](const PerftTask &task, std::size_t worker) {
+		// Boards are small, so each task replays its path on a fresh copy
+		// of the root and never has to unmake it
+		ChessBoard worker_board = board;
+		for (std::size_t i = 0; i < task.path_length; i++) {
+			UndoEntry undo;
+			worker_board.MakeMove(task.path[i], undo);
+		}
+
+		if (task.depth > PERFT_SPLIT_DEPTH && task.path_length < PERFT_MAX_TASK_PATH) {
+			MoveList moves;
+			GenerateMoves<Index>(worker_board, moves);
+
+			PerftTask child = task;
+			child.path_length++;
+			child.depth--;
+			for (const Move &move : moves) {
+				child.path[task.path_length] = move;
+				pool.Push(worker, child);
+			}
+		} else {
+			const std::uint64_t nodes = perft<Index>(worker_board, task.depth, table);
+			divide[task.root_index].fetch_add(nodes, std::memory_order_relaxed);
+		}
+	});
+
+	result.total = 0;
+	for (std::size_t i = 0; i < result.root_moves.Size(); i++) {
+		result.divide[i] = divide[i].load();
+		result.total += result.divide[i];
+	}
+}
+
+void ParallelPerft(const ChessBoard &board, unsigned depth, std::size_t thread_count, PerftResult &result, PerftTable *table)
+{
+	WithSlidingIndex([&](auto index) { parallel_perft<decltype(index)::value>(board, depth, thread_count, result, table); });
+}
+
+int RunPerftCommand(int argc, char *argv[])
+{
+	CommandOptions options;
+	options.thread_count = std::max(1u, std::thread::hardware_concurrency());
+	options.hash_megabytes = 0;
+	std::vector<const char *> args;
+
+	for (int i = 0; i < argc; i++) {
+		if (!ParseCommandOption(argc, argv, i, options))
+			args.push_back(argv[i]);
+	}
+
+	if (args.empty()) {
+		std::fprintf(stderr, "usage: perft [--threads N] [--hash MB] <depth> [fen]\n");
+		return 1;
+	}
+
+	char *depth_end = nullptr;
+	const unsigned long depth = std::strtoul(args[0], &depth_end, 10);
+	if (*depth_end != '\0' || depth < 1 || depth > 255) {
+		std::fprintf(stderr, "perft: depth must be a number from 1 to 255\n");
+		return 1;
+	}
+
+	ChessBoard board;
+	if (!LoadCommandFEN("perft", args, 1, board))
+		return 1;
+
+	std::unique_ptr<PerftTable> table;
+	if (options.hash_megabytes > 0)
+		table.reset(new PerftTable(options.hash_megabytes));
+
+	const auto start = std::chrono::steady_clock::now();
+
+	PerftResult result;
+	ParallelPerft(board, depth, options.thread_count, result, table.get());
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	const double seconds = elapsed.count();
+
+	for (std::size_t i = 0; i < result.root_moves.Size(); i++) {
+		char name[6];
+		FormatMove(result.root_moves[i], name);
+		std::printf("%s: %llu\n", name, static_cast<unsigned long long>(result.divide[i]));
+	}
+
+	std::printf("\nNodes searched: %llu\n", static_cast<unsigned long long>(result.total));
+	std::printf("Threads: %u\n", static_cast<unsigned>(options.thread_count));
+	std::printf("Sliding attacks: %s\n", (ActiveSlidingIndex() == SlidingIndexPext) ? "pext" : "magic");
+	std::printf("Time: %.3f s\n", seconds);
+	std::printf("Nodes/second: %.0f\n", (seconds > 0) ? result.total / seconds : 0.0);
+
+	return 0;
+}
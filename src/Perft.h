@@ -0,0 +1,50 @@
+#ifndef PERFT_INCLUDE_H
+#define PERFT_INCLUDE_H
+#include "ChessBoard.h"
+#include "MoveList.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Cache of (hash, depth) -> node count shared by every perft thread
+// without locks. Each entry stores its key XORed with its data, so an
+// entry torn by two threads writing at once fails verification and is
+// treated as a miss instead of returning a wrong count.
+class PerftTable {
+private:
+	struct Entry {
+		std::atomic<std::uint64_t> check;
+		// Node count in the upper 56 bits, depth in the lowest 8
+		std::atomic<std::uint64_t> data;
+	};
+
+	std::unique_ptr<Entry[]> m_entries;
+	std::size_t m_mask = 0;
+public:
+	// Rounds the size down to a power of two entries
+	explicit PerftTable(std::size_t megabytes);
+
+	bool Probe(HashKey hash, unsigned depth, std::uint64_t &nodes) const;
+	void Store(HashKey hash, unsigned depth, std::uint64_t nodes);
+};
+
+// Counts the positions reachable in exactly depth moves. Subtree counts
+// are looked up in and added to table when one is given.
+std::uint64_t Perft(ChessBoard &board, unsigned depth, PerftTable *table = nullptr);
+
+struct PerftResult {
+	MoveList root_moves;
+	// Nodes below each root move, in the same order as root_moves
+	std::uint64_t divide[MoveList::CAPACITY];
+	std::uint64_t total;
+};
+
+// Perft split over thread_count threads. Subtrees are handed out through
+// a work-stealing pool, so a few huge root moves can't leave threads idle.
+void ParallelPerft(const ChessBoard &board, unsigned depth, std::size_t thread_count, PerftResult &result, PerftTable *table = nullptr);
+
+// Headless "perft [--threads N] [--hash MB] <depth> [fen]" command. Prints the node count below
+// every root move, the total and the speed. Returns the process exit code.
+int RunPerftCommand(int argc, char *argv[]);
+
+#endif // PERFT_INCLUDE_H
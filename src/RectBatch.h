@@ -0,0 +1,44 @@
+#ifndef RECTBATCH_INCLUDE_H
+#define RECTBATCH_INCLUDE_H
+#include <SDL2/SDL.h>
+#include <cstddef>
+#include <vector>
+
+// Collects filled rectangles grouped by colour, so a whole overlay costs
+// one SDL_SetRenderDrawColor and one SDL_RenderFillRects per colour
+// instead of a pair of calls per rectangle. Colours are drawn in the
+// order they were first added. Storage is kept between frames.
+class RectBatch {
+private:
+	struct Group {
+		SDL_Color color;
+		std::vector<SDL_Rect> rects;
+	};
+
+	std::vector<Group> m_groups;
+public:
+	void Add(const SDL_Color &color, const SDL_Rect &rect) {
+		for (Group &group : m_groups) {
+			if (group.color.r == color.r && group.color.g == color.g
+				&& group.color.b == color.b && group.color.a == color.a) {
+				group.rects.push_back(rect);
+				return;
+			}
+		}
+		m_groups.push_back({ color, { rect } });
+	}
+
+	// Draws everything added since the last call and empties the batch
+	void Submit(SDL_Renderer *renderer) {
+		for (Group &group : m_groups) {
+			if (group.rects.empty())
+				continue;
+
+			SDL_SetRenderDrawColor(renderer, group.color.r, group.color.g, group.color.b, group.color.a);
+			SDL_RenderFillRects(renderer, group.rects.data(), int(group.rects.size()));
+			group.rects.clear();
+		}
+	}
+};
+
+#endif // RECTBATCH_INCLUDE_H
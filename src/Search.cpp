@@ -0,0 +1,595 @@
+#include "Search.h"
+#include "CommandLine.h"
+#include "Evaluate.h"
+#include "MoveGen.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Iterations past this are never started, leaving room below SEARCH_MAX_PLY
+// for check extensions and quiescence
+static constexpr unsigned SEARCH_MAX_DEPTH = 64;
+
+// How often, in nodes, the clock and node limit are looked at
+static constexpr std::uint64_t SEARCH_CHECK_INTERVAL = 2048;
+
+static constexpr std::size_t SEARCH_DEFAULT_HASH_MB = 16;
+
+static constexpr int ORDER_TABLE = 2000000;
+static constexpr int ORDER_PV = 1000000;
+static constexpr int ORDER_CAPTURE = 100000;
+static constexpr int ORDER_KILLER = 90000;
+
+// Cost rank of an attacker, cheapest lowest, indexed by PieceType. Breaks
+// ties between captures of the same victim.
+static constexpr int s_attacker_rank[PieceTypeNone] = { 0, 3, 1, 2, 4, 5 };
+
+// Depth skipping pattern for helper threads: helper i skips a depth when
+// ((depth + phase) / size) is odd, so helpers alternate between blocks
+// of depths and spread out over the next few iterations
+static const unsigned s_skip_size[] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+static const unsigned s_skip_phase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+Searcher::Searcher(TranspositionTable &table, const std::atomic<bool> &stop, std::size_t thread_index)
+	: m_table(table), m_stop(stop), m_thread_index(thread_index)
+{
+}
+
+bool Searcher::skips_depth(unsigned depth) const
+{
+	if (m_thread_index == 0)
+		return false;
+
+	const std::size_t pattern = (m_thread_index - 1) % (sizeof(s_skip_size) / sizeof(s_skip_size[0]));
+	return ((depth + s_skip_phase[pattern]) / s_skip_size[pattern]) % 2 != 0;
+}
+
+// Mate scores are stored relative to the node rather than the root, so
+// they stay right when the position is reached at a different ply
+static int score_to_table(int score, unsigned ply)
+{
+	if (score > SCORE_MATE - int(SEARCH_MAX_PLY))
+		return score + int(ply);
+	if (score < -SCORE_MATE + int(SEARCH_MAX_PLY))
+		return score - int(ply);
+	return score;
+}
+
+static int score_from_table(int score, unsigned ply)
+{
+	if (score > SCORE_MATE - int(SEARCH_MAX_PLY))
+		return score - int(ply);
+	if (score < -SCORE_MATE + int(SEARCH_MAX_PLY))
+		return score + int(ply);
+	return score;
+}
+
+void Searcher::make_move(Move move, UndoEntry &undo)
+{
+	m_board.MakeMove(move, undo);
+	m_hashes.push_back(m_board.GetHash());
+}
+
+void Searcher::unmake_move(const UndoEntry &undo)
+{
+	m_hashes.pop_back();
+	m_board.UnmakeMove(undo);
+}
+
+bool Searcher::should_stop()
+{
+	if (m_aborted)
+		return true;
+	if (!m_can_abort)
+		return false;
+
+	const std::uint64_t nodes = GetNodes();
+	if (m_stop.load(std::memory_order_relaxed) || (m_limits.stop && m_limits.stop->load(std::memory_order_relaxed))) {
+		m_aborted = true;
+	} else if (nodes % SEARCH_CHECK_INTERVAL == 0) {
+		const auto elapsed = std::chrono::steady_clock::now() - m_start;
+		if (m_limits.movetime_ms && elapsed >= std::chrono::milliseconds(m_limits.movetime_ms))
+			m_aborted = true;
+		if (m_limits.nodes && nodes >= m_limits.nodes)
+			m_aborted = true;
+	}
+	return m_aborted;
+}
+
+void Searcher::score_moves(const MoveList &moves, int *scores, unsigned ply, bool follow_pv, Move table_move) const
+{
+	const Move pv_move = (follow_pv && ply < m_previous_pv_length) ? m_previous_pv[ply] : Move::None();
+	const Player us = m_board.GetSideToMove();
+
+	for (std::size_t i = 0; i < moves.Size(); i++) {
+		const Move move = moves[i];
+
+		if (move == table_move) {
+			scores[i] = ORDER_TABLE;
+		} else if (move == pv_move) {
+			scores[i] = ORDER_PV;
+		} else if (move.IsCapture() || move.IsPromotion()) {
+			// Most valuable victim first, cheapest attacker breaking ties
+			const PieceType victim = move.IsEnPassant() ? PieceTypePawn : m_board.GetPiece(move.To()).GetType();
+			const PieceType attacker = m_board.GetPiece(move.From()).GetType();
+			scores[i] = ORDER_CAPTURE + (move.IsCapture() ? PieceValues[victim] * 16 : 0) - s_attacker_rank[attacker];
+			if (move.IsPromotion())
+				scores[i] += PieceValues[move.PromotionType()];
+		} else if (move == m_killers[ply][0]) {
+			scores[i] = ORDER_KILLER;
+		} else if (move == m_killers[ply][1]) {
+			scores[i] = ORDER_KILLER - 1;
+		} else {
+			scores[i] = m_history[us][move.From()][move.To()];
+		}
+	}
+}
+
+// Swaps the best scoring move still to be searched into position index
+static void pick_move(MoveList &moves, int *scores, std::size_t index)
+{
+	std::size_t best = index;
+	for (std::size_t i = index + 1; i < moves.Size(); i++) {
+		if (scores[i] > scores[best])
+			best = i;
+	}
+	std::swap(moves[index], moves[best]);
+	std::swap(scores[index], scores[best]);
+}
+
+void Searcher::update_pv(unsigned ply, Move move)
+{
+	m_pv[ply][ply] = move;
+	for (std::size_t i = ply + 1; i < m_pv_length[ply + 1]; i++)
+		m_pv[ply][i] = m_pv[ply + 1][i];
+	m_pv_length[ply] = m_pv_length[ply + 1];
+}
+
+template <SlidingIndex Index>
+int Searcher::quiesce(int alpha, int beta, unsigned ply)
+{
+	m_pv_length[ply] = ply;
+	count_node();
+	if (should_stop())
+		return 0;
+
+	const bool in_check = m_board.InCheck<Index>(m_board.GetSideToMove());
+	if (ply >= SEARCH_MAX_PLY - 1)
+		return in_check ? 0 : Evaluate(m_board);
+
+	// Standing pat is not an option when in check, every evasion is tried
+	if (!in_check) {
+		const int stand_pat = Evaluate(m_board);
+		if (stand_pat >= beta)
+			return stand_pat;
+		alpha = std::max(alpha, stand_pat);
+	}
+
+	MoveList moves;
+	GenerateMoves<Index>(m_board, moves);
+	if (moves.Empty())
+		return in_check ? -SCORE_MATE + int(ply) : 0;
+
+	int scores[MoveList::CAPACITY];
+	score_moves(moves, scores, ply, false, Move::None());
+
+	int best = in_check ? -SCORE_INFINITE : alpha;
+	for (std::size_t i = 0; i < moves.Size(); i++) {
+		pick_move(moves, scores, i);
+		const Move move = moves[i];
+		if (!in_check && !move.IsCapture() && !(move.IsPromotion() && move.PromotionType() == PieceTypeQueen))
+			continue;
+
+		UndoEntry undo;
+		make_move(move, undo);
+		const int score = -quiesce<Index>(-beta, -alpha, ply + 1);
+		unmake_move(undo);
+
+		if (m_aborted)
+			return 0;
+		if (score > best) {
+			best = score;
+			if (score > alpha) {
+				alpha = score;
+				update_pv(ply, move);
+				if (score >= beta)
+					break;
+			}
+		}
+	}
+	return best;
+}
+
+template <SlidingIndex Index>
+int Searcher::search(int alpha, int beta, int depth, unsigned ply, bool follow_pv)
+{
+	m_pv_length[ply] = ply;
+
+	if (ply > 0 && (m_board.GetHalfmoveClock() >= 100 || IsRepetition(m_hashes.data(), m_hashes.size(), m_board.GetHalfmoveClock())))
+		return 0;
+
+	const bool in_check = m_board.InCheck<Index>(m_board.GetSideToMove());
+	if (in_check)
+		depth++;
+	if (depth <= 0 || ply >= SEARCH_MAX_PLY - 1)
+		return quiesce<Index>(alpha, beta, ply);
+
+	count_node();
+	if (should_stop())
+		return 0;
+
+	const bool pv_node = beta - alpha > 1;
+	const int original_alpha = alpha;
+
+	// Outside the PV a deep enough stored bound settles the node outright
+	TTEntry entry;
+	Move table_move = Move::None();
+	if (m_table.Probe(m_board.GetHash(), entry)) {
+		table_move = entry.move;
+		const int score = score_from_table(entry.score, ply);
+		if (!pv_node && entry.depth >= depth
+			&& (entry.bound == TTBoundExact
+				|| (entry.bound == TTBoundLower && score >= beta)
+				|| (entry.bound == TTBoundUpper && score <= alpha)))
+			return score;
+	}
+
+	MoveList moves;
+	GenerateMoves<Index>(m_board, moves);
+	if (moves.Empty())
+		return in_check ? -SCORE_MATE + int(ply) : 0;
+
+	int scores[MoveList::CAPACITY];
+	score_moves(moves, scores, ply, follow_pv, table_move);
+
+	const Player us = m_board.GetSideToMove();
+	int best = -SCORE_INFINITE;
+	Move best_move = Move::None();
+
+	for (std::size_t i = 0; i < moves.Size(); i++) {
+		pick_move(moves, scores, i);
+		const Move move = moves[i];
+		const bool quiet = !move.IsCapture() && !move.IsPromotion();
+
+		UndoEntry undo;
+		make_move(move, undo);
+
+		int score;
+		if (i == 0) {
+			score = -search<Index>(-beta, -alpha, depth - 1, ply + 1, follow_pv && ply < m_previous_pv_length && move == m_previous_pv[ply]);
+		} else {
+			// Late quiet moves are searched shallower first, and only
+			// searched to full depth if they turn out better than expected
+			int reduction = 0;
+			if (quiet && !in_check && depth >= 3 && i >= 3 && scores[i] < ORDER_KILLER - 1)
+				reduction = (i >= 6) ? 2 : 1;
+
+			score = -search<Index>(-alpha - 1, -alpha, depth - 1 - reduction, ply + 1, false);
+			if (score > alpha && reduction)
+				score = -search<Index>(-alpha - 1, -alpha, depth - 1, ply + 1, false);
+			if (score > alpha && score < beta)
+				score = -search<Index>(-beta, -alpha, depth - 1, ply + 1, false);
+		}
+
+		unmake_move(undo);
+
+		if (m_aborted)
+			return 0;
+		if (score <= best)
+			continue;
+
+		best = score;
+		if (score <= alpha)
+			continue;
+
+		alpha = score;
+		best_move = move;
+		if (pv_node || ply == 0)
+			update_pv(ply, move);
+
+		if (score >= beta) {
+			if (quiet) {
+				if (m_killers[ply][0] != move) {
+					m_killers[ply][1] = m_killers[ply][0];
+					m_killers[ply][0] = move;
+				}
+				m_history[us][move.From()][move.To()] = std::min(m_history[us][move.From()][move.To()] + depth * depth, ORDER_KILLER - 2);
+			}
+			break;
+		}
+	}
+
+	const TTBound bound = (best >= beta) ? TTBoundLower : (alpha > original_alpha) ? TTBoundExact : TTBoundUpper;
+	m_table.Store(m_board.GetHash(), best_move, score_to_table(best, ply), unsigned(depth), bound);
+
+	return best;
+}
+
+SearchInfo Searcher::Search(const ChessBoard &board, const HashKey *history, std::size_t history_size, const SearchLimits &limits, const SearchReporter &report)
+{
+	m_board = board;
+	m_hashes.clear();
+	m_hashes.reserve(history_size + SEARCH_MAX_PLY + 1);
+	m_hashes.insert(m_hashes.end(), history, history + history_size);
+	m_hashes.push_back(board.GetHash());
+	m_limits = limits;
+	m_start = std::chrono::steady_clock::now();
+	m_aborted = false;
+	m_can_abort = m_thread_index != 0;
+	m_nodes.store(0, std::memory_order_relaxed);
+	m_previous_pv_length = 0;
+
+	for (auto &killers : m_killers)
+		killers[0] = killers[1] = Move::None();
+	std::memset(m_history, 0, sizeof(m_history));
+
+	SearchInfo info;
+
+	MoveList root_moves;
+	GenerateMoves(m_board, root_moves);
+	if (root_moves.Empty()) {
+		info.score = m_board.InCheck(m_board.GetSideToMove()) ? -SCORE_MATE : 0;
+		return info;
+	}
+
+	const unsigned max_depth = limits.depth ? std::min(limits.depth, SEARCH_MAX_DEPTH) : SEARCH_MAX_DEPTH;
+	for (unsigned depth = 1; depth <= max_depth; depth++) {
+		if (depth < max_depth && skips_depth(depth))
+			continue;
+
+		const int score = WithSlidingIndex([this, depth](auto index) {
+			return search<decltype(index)::value>(-SCORE_INFINITE, SCORE_INFINITE, int(depth), 0, true);
+		});
+		if (m_aborted)
+			break;
+
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+
+		info.depth = depth;
+		info.score = score;
+		info.nodes = GetNodes();
+		info.seconds = elapsed.count();
+		info.nps = (info.seconds > 0) ? std::uint64_t(info.nodes / info.seconds) : 0;
+		info.hashfull = m_table.Hashfull();
+		info.pv_length = m_pv_length[0];
+		std::copy(m_pv[0], m_pv[0] + info.pv_length, info.pv);
+
+		std::copy(info.pv, info.pv + info.pv_length, m_previous_pv);
+		m_previous_pv_length = info.pv_length;
+		m_can_abort = true;
+
+		if (report)
+			report(info);
+
+		// A forced mate found within the horizon can't get any shorter
+		if (IsMateScore(score) && SCORE_MATE - std::abs(score) <= int(depth))
+			break;
+		// The next iteration takes several times longer than this one
+		if (limits.movetime_ms && elapsed * 2 >= std::chrono::milliseconds(limits.movetime_ms))
+			break;
+	}
+
+	return info;
+}
+
+SmpSearch::SmpSearch(TranspositionTable &table, std::size_t thread_count) : m_table(table)
+{
+	for (std::size_t i = 0; i < std::max<std::size_t>(1, thread_count); i++)
+		m_searchers.emplace_back(new Searcher(table, m_stop, i));
+}
+
+std::uint64_t SmpSearch::total_nodes() const
+{
+	std::uint64_t nodes = 0;
+	for (const auto &searcher : m_searchers)
+		nodes += searcher->GetNodes();
+	return nodes;
+}
+
+// Picks the thread whose best move collects the most votes. Each thread
+// votes for its move with a weight growing with both the depth it
+// finished and how much better its score is than the worst thread's.
+// Only threads that got at least as deep as the main thread can win, so
+// helpers stopped early in a shallower iteration never override it.
+static const SearchInfo &vote_best_result(const std::vector<SearchInfo> &results)
+{
+	int min_score = SCORE_INFINITE;
+	for (const SearchInfo &result : results) {
+		if (result.depth)
+			min_score = std::min(min_score, result.score);
+	}
+
+	std::vector<std::int64_t> votes(results.size(), 0);
+	for (std::size_t i = 0; i < results.size(); i++) {
+		if (!results[i].depth)
+			continue;
+
+		const std::int64_t weight = std::int64_t(results[i].score - min_score + 14) * results[i].depth;
+		for (std::size_t j = 0; j < results.size(); j++) {
+			if (results[j].BestMove() == results[i].BestMove())
+				votes[j] += weight;
+		}
+	}
+
+	std::size_t best = 0;
+	for (std::size_t i = 1; i < results.size(); i++) {
+		if (results[i].depth < results[0].depth)
+			continue;
+
+		// A proven mate beats any vote, and a shorter one beats a longer one
+		if (IsMateScore(results[best].score) || IsMateScore(results[i].score)) {
+			if (results[i].score > results[best].score)
+				best = i;
+		} else if (votes[i] > votes[best] || (votes[i] == votes[best] && results[i].depth > results[best].depth)) {
+			best = i;
+		}
+	}
+	return results[best];
+}
+
+SearchInfo SmpSearch::Search(const ChessBoard &board, const HashKey *history, std::size_t history_size, const SearchLimits &limits, const SearchReporter &report)
+{
+	const auto start = std::chrono::steady_clock::now();
+	m_stop.store(false, std::memory_order_relaxed);
+	m_table.NewSearch();
+
+	std::vector<SearchInfo> results(m_searchers.size());
+
+	// Helpers run until the main thread is done with them
+	SearchLimits helper_limits;
+	helper_limits.depth = limits.depth;
+	helper_limits.stop = limits.stop;
+
+	std::vector<std::thread> helpers;
+	for (std::size_t i = 1; i < m_searchers.size(); i++) {
+		helpers.emplace_back([this, &board, history, history_size, &results, &helper_limits, i]() {
+			results[i] = m_searchers[i]->Search(board, history, history_size, helper_limits);
+		});
+	}
+
+	// Reports count the nodes of every thread, not just the main one
+	SearchReporter main_report = nullptr;
+	if (report) {
+		main_report = [this, &report](const SearchInfo &info) {
+			SearchInfo total = info;
+			total.nodes = total_nodes();
+			total.nps = (total.seconds > 0) ? std::uint64_t(total.nodes / total.seconds) : 0;
+			report(total);
+		};
+	}
+
+	results[0] = m_searchers[0]->Search(board, history, history_size, limits, main_report);
+
+	m_stop.store(true, std::memory_order_relaxed);
+	for (std::thread &helper : helpers)
+		helper.join();
+
+	SearchInfo best = vote_best_result(results);
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	best.nodes = total_nodes();
+	best.seconds = elapsed.count();
+	best.nps = (best.seconds > 0) ? std::uint64_t(best.nodes / best.seconds) : 0;
+	return best;
+}
+
+void FormatScore(int score, char *out, std::size_t size)
+{
+	if (IsMateScore(score)) {
+		const int plies = SCORE_MATE - std::abs(score);
+		const int moves = (plies + 1) / 2;
+		std::snprintf(out, size, "mate %d", (score > 0) ? moves : -moves);
+	} else {
+		std::snprintf(out, size, "cp %d", score);
+	}
+}
+
+static void print_search_info(const SearchInfo &info)
+{
+	char score[24];
+	FormatScore(info.score, score, sizeof(score));
+
+	std::printf("info depth %u score %s nodes %llu nps %llu hashfull %u time %llu pv",
+		info.depth, score,
+		static_cast<unsigned long long>(info.nodes),
+		static_cast<unsigned long long>(info.nps),
+		info.hashfull,
+		static_cast<unsigned long long>(info.seconds * 1000));
+
+	for (std::size_t i = 0; i < info.pv_length; i++) {
+		char name[6];
+		FormatMove(info.pv[i], name);
+		std::printf(" %s", name);
+	}
+	std::printf("\n");
+	std::fflush(stdout);
+}
+
+// Searches the same position with a doubling number of threads, starting
+// from an empty table each time, and compares each run with one thread
+static int run_scaling_benchmark(const ChessBoard &board, const SearchLimits &limits, std::size_t max_threads, TranspositionTable &table)
+{
+	double base_seconds = 0;
+	std::uint64_t base_nps = 0;
+
+	std::printf("%8s %10s %14s %12s %12s %10s %8s\n", "threads", "depth", "nodes", "time", "nps", "ttd gain", "nps gain");
+
+	for (std::size_t threads = 1;; threads = std::min(threads * 2, max_threads)) {
+		table.Clear(max_threads);
+
+		SmpSearch search(table, threads);
+		const SearchInfo info = search.Search(board, nullptr, 0, limits);
+
+		if (threads == 1) {
+			base_seconds = info.seconds;
+			base_nps = info.nps;
+		}
+
+		std::printf("%8u %10u %14llu %10.3f s %12llu %9.2fx %7.2fx\n",
+			static_cast<unsigned>(threads), info.depth,
+			static_cast<unsigned long long>(info.nodes), info.seconds,
+			static_cast<unsigned long long>(info.nps),
+			(info.seconds > 0) ? base_seconds / info.seconds : 0.0,
+			base_nps ? double(info.nps) / base_nps : 0.0);
+		std::fflush(stdout);
+
+		// The last run uses max_threads even when it isn't a power of two
+		if (threads == max_threads)
+			break;
+	}
+	return 0;
+}
+
+int RunSearchCommand(int argc, char *argv[])
+{
+	SearchLimits limits;
+	CommandOptions options;
+	options.thread_count = 1;
+	options.hash_megabytes = SEARCH_DEFAULT_HASH_MB;
+	bool scaling = false;
+	std::vector<const char *> args;
+
+	for (int i = 0; i < argc; i++) {
+		if (ParseCommandOption(argc, argv, i, options))
+			continue;
+
+		if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+			limits.depth = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--movetime") == 0 && i + 1 < argc)
+			limits.movetime_ms = std::strtoull(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--scaling") == 0)
+			scaling = true;
+		else
+			args.push_back(argv[i]);
+	}
+
+	if (!limits.depth && !limits.movetime_ms)
+		limits.depth = 8;
+
+	ChessBoard board;
+	if (!LoadCommandFEN("search", args, 0, board))
+		return 1;
+
+	TranspositionTable table(options.hash_megabytes, options.thread_count);
+
+	// The table is rounded down to a power of two buckets, so report the
+	// size actually used
+	std::printf("info string hash %.1f MB\n", table.GetSizeBytes() / (1024.0 * 1024.0));
+
+	if (scaling)
+		return run_scaling_benchmark(board, limits, options.thread_count, table);
+
+	SmpSearch search(table, options.thread_count);
+	const SearchInfo info = search.Search(board, nullptr, 0, limits, print_search_info);
+
+	char name[6] = "0000";
+	if (!info.BestMove().IsNone())
+		FormatMove(info.BestMove(), name);
+	std::printf("bestmove %s\n", name);
+
+	return 0;
+}
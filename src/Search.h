@@ -0,0 +1,149 @@
+#ifndef SEARCH_INCLUDE_H
+#define SEARCH_INCLUDE_H
+#include "ChessBoard.h"
+#include "MoveList.h"
+#include "TranspositionTable.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Deepest ply the search reaches, quiescence included
+constexpr unsigned SEARCH_MAX_PLY = 128;
+
+constexpr int SCORE_INFINITE = 32000;
+// Mate in n plies scores SCORE_MATE - n
+constexpr int SCORE_MATE = 31000;
+
+constexpr bool IsMateScore(int score)
+{
+	return score > SCORE_MATE - int(SEARCH_MAX_PLY) || score < -SCORE_MATE + int(SEARCH_MAX_PLY);
+}
+
+// Whichever limit is hit first ends the search. Zero means no limit.
+struct SearchLimits {
+	unsigned depth = 0;
+	std::uint64_t movetime_ms = 0;
+	std::uint64_t nodes = 0;
+	// Ends the search when set, for callers that can't reach the searcher
+	const std::atomic<bool> *stop = nullptr;
+};
+
+// Result of one finished iteration of iterative deepening
+struct SearchInfo {
+	unsigned depth = 0;
+	// Centipawns from the point of view of the side to move
+	int score = 0;
+	std::uint64_t nodes = 0;
+	double seconds = 0;
+	std::uint64_t nps = 0;
+	// Permille of the transposition table used by this search
+	unsigned hashfull = 0;
+	Move pv[SEARCH_MAX_PLY];
+	std::size_t pv_length = 0;
+
+	Move BestMove() const { return pv_length ? pv[0] : Move::None(); }
+};
+
+typedef std::function<void(const SearchInfo &info)> SearchReporter;
+
+// Iterative deepening principal variation search. Each iteration searches
+// the first move with a full window and the rest with a null window,
+// re-searching only the ones that beat it. Moves are ordered by the
+// transposition table move, the previous iteration's PV, MVV-LVA for
+// captures, then killers and history.
+class Searcher {
+private:
+	ChessBoard m_board;
+	TranspositionTable &m_table;
+	const std::atomic<bool> &m_stop;
+	// Zero for the main thread. Helpers skip some depths based on it.
+	std::size_t m_thread_index;
+	SearchLimits m_limits;
+	std::chrono::steady_clock::time_point m_start;
+	bool m_aborted = false;
+	// The main thread always finishes its first iteration, so there is
+	// a move to play
+	bool m_can_abort = false;
+
+	// Hash of every position from the start of the game history down to
+	// the current node, for spotting repetitions
+	std::vector<HashKey> m_hashes;
+
+	// Written only by the searching thread, read by others for reports
+	std::atomic<std::uint64_t> m_nodes{ 0 };
+
+	// Triangular PV table: m_pv[ply] holds the best line found from ply
+	Move m_pv[SEARCH_MAX_PLY][SEARCH_MAX_PLY];
+	std::size_t m_pv_length[SEARCH_MAX_PLY];
+	// Best line of the last finished iteration, tried first in the next
+	Move m_previous_pv[SEARCH_MAX_PLY];
+	std::size_t m_previous_pv_length = 0;
+
+	Move m_killers[SEARCH_MAX_PLY][2];
+	int m_history[PlayerNone][64][64];
+
+	void count_node() { m_nodes.store(m_nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+	void make_move(Move move, UndoEntry &undo);
+	void unmake_move(const UndoEntry &undo);
+	bool should_stop();
+	bool skips_depth(unsigned depth) const;
+	void score_moves(const MoveList &moves, int *scores, unsigned ply, bool follow_pv, Move table_move) const;
+	// Instantiated for each SlidingIndex; Search picks one per run
+	template <SlidingIndex Index>
+	int search(int alpha, int beta, int depth, unsigned ply, bool follow_pv);
+	template <SlidingIndex Index>
+	int quiesce(int alpha, int beta, unsigned ply);
+	void update_pv(unsigned ply, Move move);
+public:
+	// Results are cached in table, which other searchers may share. The
+	// search ends early once stop is set.
+	Searcher(TranspositionTable &table, const std::atomic<bool> &stop, std::size_t thread_index);
+
+	// Searches board until a limit is hit or stop is set, calling report
+	// after every finished iteration. history holds the hashes of the
+	// positions played before board, oldest first; repeating any of them
+	// scores as a draw. Returns the last finished iteration, which has
+	// depth 0 if none finished.
+	SearchInfo Search(const ChessBoard &board, const HashKey *history, std::size_t history_size, const SearchLimits &limits, const SearchReporter &report = nullptr);
+
+	std::uint64_t GetNodes() const { return m_nodes.load(std::memory_order_relaxed); }
+};
+
+// Lazy SMP: every thread runs its own Searcher on the same root, and the
+// only thing they share is the transposition table. Helpers skip some
+// depths, so at any time threads are spread over neighbouring depths and
+// fill the table with results the others pick up. The main thread alone
+// watches the clock and reports; when it finishes, the helpers are
+// stopped and the threads' best moves are weighed by depth and score.
+class SmpSearch {
+private:
+	TranspositionTable &m_table;
+	std::atomic<bool> m_stop{ false };
+	std::vector<std::unique_ptr<Searcher>> m_searchers;
+
+	std::uint64_t total_nodes() const;
+public:
+	SmpSearch(TranspositionTable &table, std::size_t thread_count);
+
+	SearchInfo Search(const ChessBoard &board, const HashKey *history, std::size_t history_size, const SearchLimits &limits, const SearchReporter &report = nullptr);
+
+	// Safe to call from any thread while Search runs
+	void Stop() { m_stop.store(true, std::memory_order_relaxed); }
+
+	std::size_t GetThreadCount() const { return m_searchers.size(); }
+};
+
+// Writes a score as "cp N" or "mate N" (moves, negative when being mated)
+void FormatScore(int score, char *out, std::size_t size);
+
+// Headless "search [--depth N] [--movetime MS] [--hash MB] [--threads N]
+// [--scaling] [fen]" command. Prints one line per iteration and the best
+// move. With --scaling it instead searches to the given depth with 1, 2,
+// 4, ... threads up to --threads and prints the time to depth and speed
+// of each. Returns the process exit code.
+int RunSearchCommand(int argc, char *argv[]);
+
+#endif // SEARCH_INCLUDE_H
@@ -0,0 +1,161 @@
+#include "SpriteScale.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// One sprite as premultiplied RGBA floats
+struct SpriteImage {
+	int width = 0;
+	int height = 0;
+	std::vector<float> pixels;
+
+	float *at(int x, int y) { return &pixels[(std::size_t(y) * width + x) * 4]; }
+	const float *at(int x, int y) const { return &pixels[(std::size_t(y) * width + x) * 4]; }
+};
+
+static SpriteImage read_cell(const SDL_Surface *sheet, int left, int top, int width, int height)
+{
+	SpriteImage image;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(std::size_t(width) * height * 4);
+
+	for (int y = 0; y < height; y++) {
+		const std::uint8_t *row = static_cast<const std::uint8_t *>(sheet->pixels) + (top + y) * sheet->pitch + left * 4;
+		for (int x = 0; x < width; x++) {
+			const float alpha = row[x * 4 + 3] / 255.f;
+			float *pixel = image.at(x, y);
+			pixel[0] = row[x * 4 + 0] / 255.f * alpha;
+			pixel[1] = row[x * 4 + 1] / 255.f * alpha;
+			pixel[2] = row[x * 4 + 2] / 255.f * alpha;
+			pixel[3] = alpha;
+		}
+	}
+	return image;
+}
+
+static void write_cell(SDL_Surface *sheet, int left, int top, const SpriteImage &image)
+{
+	for (int y = 0; y < image.height; y++) {
+		std::uint8_t *row = static_cast<std::uint8_t *>(sheet->pixels) + (top + y) * sheet->pitch + left * 4;
+		for (int x = 0; x < image.width; x++) {
+			const float *pixel = image.at(x, y);
+			const float alpha = pixel[3];
+			const float unpremultiply = (alpha > 0) ? 1.f / alpha : 0.f;
+			for (int c = 0; c < 3; c++)
+				row[x * 4 + c] = std::uint8_t(std::clamp(pixel[c] * unpremultiply, 0.f, 1.f) * 255.f + 0.5f);
+			row[x * 4 + 3] = std::uint8_t(std::clamp(alpha, 0.f, 1.f) * 255.f + 0.5f);
+		}
+	}
+}
+
+// Next mip level: every pixel averages a 2x2 block. The last pixel of a
+// row or column also takes in an odd source row or column left over, so
+// no source pixel is dropped.
+static SpriteImage halve(const SpriteImage &image)
+{
+	SpriteImage half;
+	half.width = std::max(1, image.width / 2);
+	half.height = std::max(1, image.height / 2);
+	half.pixels.resize(std::size_t(half.width) * half.height * 4);
+
+	for (int y = 0; y < half.height; y++) {
+		const int y0 = y * 2;
+		const int y1 = (y + 1 == half.height) ? image.height : y0 + 2;
+
+		for (int x = 0; x < half.width; x++) {
+			const int x0 = x * 2;
+			const int x1 = (x + 1 == half.width) ? image.width : x0 + 2;
+
+			float sum[4] = {};
+			for (int source_y = y0; source_y < y1; source_y++) {
+				for (int source_x = x0; source_x < x1; source_x++) {
+					for (int c = 0; c < 4; c++)
+						sum[c] += image.at(source_x, source_y)[c];
+				}
+			}
+
+			const float weight = 1.f / float((x1 - x0) * (y1 - y0));
+			float *out = half.at(x, y);
+			for (int c = 0; c < 4; c++)
+				out[c] = sum[c] * weight;
+		}
+	}
+	return half;
+}
+
+static SpriteImage resample_bilinear(const SpriteImage &image, int width, int height)
+{
+	SpriteImage scaled;
+	scaled.width = width;
+	scaled.height = height;
+	scaled.pixels.resize(std::size_t(width) * height * 4);
+
+	const float scale_x = float(image.width) / width;
+	const float scale_y = float(image.height) / height;
+
+	for (int y = 0; y < height; y++) {
+		// Sample at pixel centres
+		const float source_y = std::clamp((y + 0.5f) * scale_y - 0.5f, 0.f, float(image.height - 1));
+		const int y0 = int(source_y);
+		const int y1 = std::min(y0 + 1, image.height - 1);
+		const float fy = source_y - y0;
+
+		for (int x = 0; x < width; x++) {
+			const float source_x = std::clamp((x + 0.5f) * scale_x - 0.5f, 0.f, float(image.width - 1));
+			const int x0 = int(source_x);
+			const int x1 = std::min(x0 + 1, image.width - 1);
+			const float fx = source_x - x0;
+
+			float *out = scaled.at(x, y);
+			for (int c = 0; c < 4; c++) {
+				const float top = image.at(x0, y0)[c] * (1 - fx) + image.at(x1, y0)[c] * fx;
+				const float bottom = image.at(x0, y1)[c] * (1 - fx) + image.at(x1, y1)[c] * fx;
+				out[c] = top * (1 - fy) + bottom * fy;
+			}
+		}
+	}
+	return scaled;
+}
+
+SDL_Surface *ScaleSpriteSheet(SDL_Surface *source, int columns, int rows, int cell_width, int cell_height)
+{
+	if (columns <= 0 || rows <= 0 || cell_width <= 0 || cell_height <= 0)
+		return nullptr;
+
+	SDL_Surface *input = SDL_ConvertSurfaceFormat(source, SDL_PIXELFORMAT_RGBA32, 0);
+	if (!input)
+		return nullptr;
+
+	SDL_Surface *output = SDL_CreateRGBSurfaceWithFormat(0, cell_width * columns, cell_height * rows, 32, SDL_PIXELFORMAT_RGBA32);
+	if (!output) {
+		SDL_FreeSurface(input);
+		return nullptr;
+	}
+
+	const int source_width = input->w / columns;
+	const int source_height = input->h / rows;
+
+	SDL_LockSurface(input);
+	SDL_LockSurface(output);
+
+	for (int row = 0; row < rows; row++) {
+		for (int column = 0; column < columns; column++) {
+			SpriteImage image = read_cell(input, column * source_width, row * source_height, source_width, source_height);
+
+			while (image.width >= cell_width * 2 && image.height >= cell_height * 2)
+				image = halve(image);
+
+			if (image.width != cell_width || image.height != cell_height)
+				image = resample_bilinear(image, cell_width, cell_height);
+
+			write_cell(output, column * cell_width, row * cell_height, image);
+		}
+	}
+
+	SDL_UnlockSurface(output);
+	SDL_UnlockSurface(input);
+	SDL_FreeSurface(input);
+
+	return output;
+}
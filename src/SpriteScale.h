@@ -0,0 +1,16 @@
+#ifndef SPRITESCALE_INCLUDE_H
+#define SPRITESCALE_INCLUDE_H
+#include <SDL2/SDL.h>
+
+// Resamples a sheet of equally sized sprites, laid out columns x rows,
+// into a new sheet whose cells are cell_width x cell_height. Each cell is
+// scaled on its own so neighbouring sprites never bleed into each other.
+//
+// Shrinking halves the sprites with a 2x2 box filter until they are
+// less than twice the target size, like building a mipmap chain, then
+// finishes with a bilinear pass from that level. Filtering is done on
+// premultiplied alpha so transparent edges don't darken. The source may
+// be any format; the result is SDL_PIXELFORMAT_RGBA32, or null on failure.
+SDL_Surface *ScaleSpriteSheet(SDL_Surface *source, int columns, int rows, int cell_width, int cell_height);
+
+#endif // SPRITESCALE_INCLUDE_H
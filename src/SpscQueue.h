@@ -0,0 +1,48 @@
+#ifndef SPSCQUEUE_INCLUDE_H
+#define SPSCQUEUE_INCLUDE_H
+#include <atomic>
+#include <cstddef>
+
+// Fixed capacity queue for exactly one producer thread and one consumer
+// thread. Neither side ever blocks or locks: a push into a full queue or
+// a pop from an empty one just fails. Head and tail live on separate
+// cache lines so the two threads don't keep stealing one line from each
+// other.
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+private:
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	T m_items[Capacity];
+	// Next slot to pop, written only by the consumer
+	alignas(64) std::atomic<std::size_t> m_head{ 0 };
+	// Next slot to push, written only by the producer
+	alignas(64) std::atomic<std::size_t> m_tail{ 0 };
+public:
+	bool TryPush(const T &item) {
+		const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+			return false;
+
+		m_items[tail % Capacity] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T &item) {
+		const std::size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false;
+
+		item = m_items[head % Capacity];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Only a hint when called from the producer side
+	bool Empty() const {
+		return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+	}
+};
+
+#endif // SPSCQUEUE_INCLUDE_H
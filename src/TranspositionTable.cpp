@@ -0,0 +1,162 @@
+#include "TranspositionTable.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Layout of a slot's data word
+static constexpr unsigned TT_SCORE_SHIFT = 16;
+static constexpr unsigned TT_DEPTH_SHIFT = 32;
+static constexpr unsigned TT_BOUND_SHIFT = 40;
+static constexpr unsigned TT_GENERATION_SHIFT = 42;
+static constexpr std::uint8_t TT_GENERATION_MASK = 0x3F;
+
+static inline std::uint64_t pack_entry(Move move, int score, unsigned depth, TTBound bound, std::uint8_t generation)
+{
+	return std::uint64_t(move.Raw())
+		| (std::uint64_t(std::uint16_t(score)) << TT_SCORE_SHIFT)
+		| (std::uint64_t(depth & 0xFF) << TT_DEPTH_SHIFT)
+		| (std::uint64_t(bound) << TT_BOUND_SHIFT)
+		| (std::uint64_t(generation) << TT_GENERATION_SHIFT);
+}
+
+static inline unsigned entry_depth(std::uint64_t data)
+{
+	return (data >> TT_DEPTH_SHIFT) & 0xFF;
+}
+
+static inline TTBound entry_bound(std::uint64_t data)
+{
+	return TTBound((data >> TT_BOUND_SHIFT) & 3);
+}
+
+static inline std::uint8_t entry_generation(std::uint64_t data)
+{
+	return (data >> TT_GENERATION_SHIFT) & TT_GENERATION_MASK;
+}
+
+TranspositionTable::TranspositionTable(std::size_t megabytes, std::size_t thread_count)
+{
+	std::size_t count = 1;
+	while (count * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024)
+		count *= 2;
+
+	// Left uninitialised so the pages are first touched by Clear's
+	// threads rather than zeroed here on one
+	m_buckets.reset(new Bucket[count]);
+	m_mask = count - 1;
+	Clear(thread_count);
+}
+
+void TranspositionTable::NewSearch()
+{
+	m_generation = (m_generation + 1) & TT_GENERATION_MASK;
+}
+
+bool TranspositionTable::Probe(HashKey hash, TTEntry &entry) const
+{
+	const Bucket &bucket = bucket_for(hash);
+
+	for (const Slot &slot : bucket.slots) {
+		const std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+		const std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+		if ((check ^ data) != hash || entry_bound(data) == TTBoundNone)
+			continue;
+
+		entry.move = Move::FromRaw(std::uint16_t(data));
+		entry.score = std::int16_t(std::uint16_t(data >> TT_SCORE_SHIFT));
+		entry.depth = std::uint8_t(entry_depth(data));
+		entry.bound = entry_bound(data);
+		return true;
+	}
+	return false;
+}
+
+void TranspositionTable::Store(HashKey hash, Move move, int score, unsigned depth, TTBound bound)
+{
+	Bucket &bucket = bucket_for(hash);
+
+	Slot *target = nullptr;
+	std::uint64_t target_data = 0;
+
+	// A slot already holding this position is updated in place, keeping
+	// its move when the new result didn't find one
+	for (Slot &slot : bucket.slots) {
+		const std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+		if ((slot.check.load(std::memory_order_relaxed) ^ data) == hash) {
+			target = &slot;
+			target_data = data;
+			break;
+		}
+	}
+
+	if (target) {
+		if (bound != TTBoundExact && depth + 2 < entry_depth(target_data)
+			&& entry_generation(target_data) == m_generation)
+			return;
+		if (move.IsNone())
+			move = Move::FromRaw(std::uint16_t(target_data));
+	} else {
+		// Evict the depth-preferred slot worth least, counting every
+		// search it has survived against it
+		int lowest_worth = 0;
+		for (std::size_t i = 0; i < BUCKET_SLOTS - 1; i++) {
+			const std::uint64_t data = bucket.slots[i].data.load(std::memory_order_relaxed);
+			const int age = (m_generation - entry_generation(data)) & TT_GENERATION_MASK;
+			const int worth = int(entry_depth(data)) - 8 * age;
+			if (!target || worth < lowest_worth) {
+				target = &bucket.slots[i];
+				target_data = data;
+				lowest_worth = worth;
+			}
+		}
+
+		// Too valuable to overwrite, so the always-replace slot takes it
+		if (entry_generation(target_data) == m_generation && depth < entry_depth(target_data))
+			target = &bucket.slots[BUCKET_SLOTS - 1];
+	}
+
+	const std::uint64_t data = pack_entry(move, score, depth, bound, m_generation);
+	target->check.store(hash ^ data, std::memory_order_relaxed);
+	target->data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::Clear(std::size_t thread_count)
+{
+	const std::size_t count = m_mask + 1;
+	thread_count = std::max<std::size_t>(1, std::min(thread_count, count));
+
+	auto clear_range = [this](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; i++) {
+			for (Slot &slot : m_buckets[i].slots) {
+				slot.check.store(0, std::memory_order_relaxed);
+				slot.data.store(0, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	const std::size_t chunk = count / thread_count;
+	for (std::size_t i = 1; i < thread_count; i++)
+		threads.emplace_back(clear_range, i * chunk, (i + 1 == thread_count) ? count : (i + 1) * chunk);
+
+	clear_range(0, chunk);
+	for (std::thread &thread : threads)
+		thread.join();
+
+	m_generation = 0;
+}
+
+unsigned TranspositionTable::Hashfull() const
+{
+	const std::size_t sample = std::min<std::size_t>(1000, m_mask + 1);
+	unsigned used = 0;
+
+	for (std::size_t i = 0; i < sample; i++) {
+		for (const Slot &slot : m_buckets[i].slots) {
+			const std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+			if (entry_bound(data) != TTBoundNone && entry_generation(data) == m_generation)
+				used++;
+		}
+	}
+	return unsigned(used * 1000 / (sample * BUCKET_SLOTS));
+}
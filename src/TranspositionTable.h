@@ -0,0 +1,76 @@
+#ifndef TRANSPOSITIONTABLE_INCLUDE_H
+#define TRANSPOSITIONTABLE_INCLUDE_H
+#include "Move.h"
+#include "Zobrist.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// What a stored score says about the real score of the position
+enum TTBound : std::uint8_t {
+	TTBoundNone = 0,
+	TTBoundUpper = 1,
+	TTBoundLower = 2,
+	TTBoundExact = TTBoundUpper | TTBoundLower
+};
+
+struct TTEntry {
+	Move move;
+	std::int16_t score;
+	std::uint8_t depth;
+	TTBound bound;
+};
+
+// Search results shared by every search thread without locks. Like
+// PerftTable, each slot stores its key XORed with its data, so a slot
+// torn by two threads writing at once reads back as a miss.
+//
+// Slots are grouped in 64 byte buckets, one cache line each. The first
+// slots of a bucket keep the deepest results, preferring to evict ones
+// left over from earlier searches. The last slot always takes whatever
+// the others turned down, so fresh shallow results still get cached.
+class TranspositionTable {
+private:
+	struct Slot {
+		std::atomic<std::uint64_t> check;
+		std::atomic<std::uint64_t> data;
+	};
+
+	static constexpr std::size_t BUCKET_SLOTS = 4;
+
+	struct alignas(64) Bucket {
+		Slot slots[BUCKET_SLOTS];
+	};
+
+	static_assert(sizeof(Bucket) == 64, "A bucket must fill exactly one cache line");
+
+	std::unique_ptr<Bucket[]> m_buckets;
+	std::size_t m_mask = 0;
+	// Bumped at the start of every search, kept in 6 bits
+	std::uint8_t m_generation = 0;
+
+	Bucket &bucket_for(HashKey hash) const { return m_buckets[hash & m_mask]; }
+public:
+	// Rounds the size down to a power of two buckets, and clears them
+	// across thread_count threads
+	TranspositionTable(std::size_t megabytes, std::size_t thread_count);
+
+	// Marks everything stored so far as older than what comes next
+	void NewSearch();
+
+	bool Probe(HashKey hash, TTEntry &entry) const;
+	void Store(HashKey hash, Move move, int score, unsigned depth, TTBound bound);
+
+	// Wipes the table, split across thread_count threads since touching
+	// every page of a table several gigabytes big takes a while
+	void Clear(std::size_t thread_count);
+
+	// Permille of the table filled by the current search, sampled from
+	// the first thousand buckets
+	unsigned Hashfull() const;
+
+	std::size_t GetSizeBytes() const { return (m_mask + 1) * sizeof(Bucket); }
+};
+
+#endif // TRANSPOSITIONTABLE_INCLUDE_H
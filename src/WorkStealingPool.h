@@ -0,0 +1,100 @@
+#ifndef WORKSTEALINGPOOL_INCLUDE_H
+#define WORKSTEALINGPOOL_INCLUDE_H
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs tasks on a fixed set of threads. Each worker owns a deque: it
+// pushes and pops its own tasks at the back (newest first, which keeps
+// its working set hot), and when it runs dry it steals from the front of
+// another worker's deque (oldest first, which tends to be the biggest
+// piece of remaining work). Handlers may push more tasks while running.
+template <typename Task>
+class WorkStealingPool {
+private:
+	struct alignas(64) WorkerQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<WorkerQueue> m_queues;
+
+	// Tasks pushed but not yet finished. Workers exit when this hits zero.
+	std::atomic<std::size_t> m_pending{0};
+
+	bool pop(std::size_t worker, Task &task) {
+		WorkerQueue &queue = m_queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			return false;
+
+		task = queue.tasks.back();
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool steal(std::size_t worker, Task &task) {
+		for (std::size_t i = 1; i < m_queues.size(); i++) {
+			WorkerQueue &queue = m_queues[(worker + i) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+				continue;
+
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	template <typename Handler>
+	void work(std::size_t worker, Handler &handler) {
+		Task task;
+		while (true) {
+			if (pop(worker, task) || steal(worker, task)) {
+				handler(task, worker);
+				m_pending.fetch_sub(1, std::memory_order_acq_rel);
+			} else if (m_pending.load(std::memory_order_acquire) == 0) {
+				break;
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+public:
+	explicit WorkStealingPool(std::size_t thread_count)
+		: m_queues(thread_count > 0 ? thread_count : 1)
+	{
+	}
+
+	std::size_t GetThreadCount() const { return m_queues.size(); }
+
+	// Queues a task on the given worker's deque. Call it before Run to
+	// seed the pool, or from a handler with the worker index it was given.
+	void Push(std::size_t worker, const Task &task) {
+		m_pending.fetch_add(1, std::memory_order_relaxed);
+
+		WorkerQueue &queue = m_queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(task);
+	}
+
+	// Calls handler(task, worker) for every task until all are done. The
+	// calling thread works as worker 0.
+	template <typename Handler>
+	void Run(Handler handler) {
+		std::vector<std::thread> threads;
+		for (std::size_t worker = 1; worker < m_queues.size(); worker++)
+			threads.emplace_back([this, worker, &handler]() { work(worker, handler); });
+
+		work(0, handler);
+
+		for (std::thread &thread : threads)
+			thread.join();
+	}
+};
+
+#endif // WORKSTEALINGPOOL_INCLUDE_H
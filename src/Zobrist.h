@@ -0,0 +1,71 @@
+#ifndef ZOBRIST_INCLUDE_H
+#define ZOBRIST_INCLUDE_H
+#include "Bitboard.h"
+#include "ChessPiece.h"
+#include <cstdint>
+
+// Hash of a position, XORed together from the keys below. Not a set of
+// squares, so it has a type of its own rather than Bitboard.
+typedef std::uint64_t HashKey;
+
+// Random keys XORed together to hash a position. They come from
+// splitmix64 with a fixed seed, evaluated at compile time, so hashes are
+// the same on every run and every build.
+struct ZobristKeys {
+	HashKey pieces[PlayerNone][PieceTypeNone][64];
+	HashKey castling[16];
+	HashKey en_passant_file[8];
+	HashKey black_to_move;
+};
+
+constexpr HashKey ZobristNext(HashKey &state)
+{
+	state += 0x9E3779B97F4A7C15ULL;
+	HashKey z = state;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys MakeZobristKeys()
+{
+	ZobristKeys keys = {};
+	HashKey state = 0x5A0B1234C0FFEEULL;
+
+	for (auto &player : keys.pieces)
+		for (auto &type : player)
+			for (HashKey &key : type)
+				key = ZobristNext(state);
+
+	// Castling keys are built from one key per right, so that dropping a
+	// right XORs out exactly that right's key
+	HashKey rights[4] = {};
+	for (HashKey &key : rights)
+		key = ZobristNext(state);
+	for (std::size_t mask = 0; mask < 16; mask++) {
+		for (std::size_t bit = 0; bit < 4; bit++) {
+			if (mask & (std::size_t(1) << bit))
+				keys.castling[mask] ^= rights[bit];
+		}
+	}
+
+	for (HashKey &key : keys.en_passant_file)
+		key = ZobristNext(state);
+
+	keys.black_to_move = ZobristNext(state);
+	return keys;
+}
+
+inline constexpr ZobristKeys Zobrist = MakeZobristKeys();
+
+inline HashKey ZobristPiece(ChessPiece piece, Square square)
+{
+	return Zobrist.pieces[piece.GetOwner()][piece.GetType()][square];
+}
+
+inline HashKey ZobristEnPassant(Square square)
+{
+	return (square == SquareNone) ? 0 : Zobrist.en_passant_file[SquareX(square)];
+}
+
+#endif // ZOBRIST_INCLUDE_H
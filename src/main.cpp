@@ -1,6 +1,14 @@
 #include "Game.h"
+#include "Perft.h"
+#include "Search.h"
 
 int main(int argc, char *argv[]) {
+	// Headless benchmark mode, no window is opened
+	if (argc >= 2 && std::strcmp(argv[1], "perft") == 0)
+		return RunPerftCommand(argc - 2, argv + 2);
+	if (argc >= 2 && std::strcmp(argv[1], "search") == 0)
+		return RunSearchCommand(argc - 2, argv + 2);
+
 	ChessGame cg(argc, argv);
 	try {
 		cg.run();
@@ -9,4 +17,4 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 	return 0;
-}
\ No newline at end of file
+}
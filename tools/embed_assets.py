@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# Regenerates src/EmbeddedAssets.cpp from the files in assets/, so the
+# game carries its sprites inside the executable. Run it from anywhere
+# after changing an asset and commit the result.
+import os
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+ASSET_DIR = os.path.join(ROOT, "assets")
+OUTPUT = os.path.join(ROOT, "src", "EmbeddedAssets.cpp")
+BYTES_PER_LINE = 16
+
+
+def array_name(file_name):
+    return "s_asset_" + "".join(c if c.isalnum() else "_" for c in file_name)
+
+
+def main():
+    names = sorted(n for n in os.listdir(ASSET_DIR) if n.endswith(".png"))
+
+    lines = [
+        "// Generated by tools/embed_assets.py from the assets directory. Do not edit.",
+        '#include "EmbeddedAssets.h"',
+        "#include <cstring>",
+        "",
+    ]
+
+    for name in names:
+        with open(os.path.join(ASSET_DIR, name), "rb") as f:
+            data = f.read()
+
+        lines.append("static const unsigned char %s[%d] = {" % (array_name(name), len(data)))
+        for i in range(0, len(data), BYTES_PER_LINE):
+            chunk = data[i:i + BYTES_PER_LINE]
+            lines.append("\t" + ", ".join("0x%02x" % b for b in chunk) + ",")
+        lines.append("};")
+        lines.append("")
+
+    lines.append("const EmbeddedAsset EmbeddedAssets[] = {")
+    for name in names:
+        lines.append('\t{ "%s", %s, sizeof(%s) },' % (name, array_name(name), array_name(name)))
+    lines.append("};")
+    lines.append("")
+    lines.append("const std::size_t EmbeddedAssetCount = sizeof(EmbeddedAssets) / sizeof(EmbeddedAssets[0]);")
+    lines.append("")
+    lines.append("const EmbeddedAsset *FindEmbeddedAsset(const char *name)")
+    lines.append("{")
+    lines.append("\tfor (const EmbeddedAsset &asset : EmbeddedAssets) {")
+    lines.append("\t\tif (std::strcmp(asset.name, name) == 0)")
+    lines.append("\t\t\treturn &asset;")
+    lines.append("\t}")
+    lines.append("\treturn nullptr;")
+    lines.append("}")
+
+    with open(OUTPUT, "w", newline="\n") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()